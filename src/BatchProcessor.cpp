@@ -0,0 +1,174 @@
+#include "BatchProcessor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "FeatureTracker.h"
+#include "Instrumentation.h"
+#include "matching2D.hpp" // KPDetector
+#include "StaticPipeline.h"
+#include "util.h" // DetectAndDescribeFeatures
+
+using namespace std;
+
+namespace
+{
+
+// pairs taken by a worker at once. Small enough to balance the load, large enough that the
+// matcher state carries over for most pairs
+const size_t kPairsPerChunk = 8;
+
+// The workers already use all cores, opencv's parallel_for_ inside the detectors and matchers
+// runs single threaded while they are busy to avoid oversubscription. The setting is process
+// wide and restored afterwards.
+class SingleThreadedOpencv
+{
+public:
+    explicit SingleThreadedOpencv(int numWorkers) : numThreads_m(cv::getNumThreads()), bActive_m(numWorkers > 1)
+    {
+        if (bActive_m)
+            cv::setNumThreads(1);
+    }
+    ~SingleThreadedOpencv()
+    {
+        if (bActive_m)
+            cv::setNumThreads(numThreads_m);
+    }
+
+private:
+    int numThreads_m;
+    bool bActive_m;
+};
+
+} // namespace
+
+
+BatchProcessor::BatchProcessor(const Params& params)
+{
+    params_m = params;
+}
+
+int BatchProcessor::NumWorkers() const
+{
+    return params_m.batchWorkers > 0 ? params_m.batchWorkers : max(1u, thread::hardware_concurrency());
+}
+
+vector<BatchFrame> BatchProcessor::Process(const cv::Mat* frames, size_t numFrames)
+{
+    vector<BatchFrame> results(numFrames);
+    DescribeFrames(nullptr, frames, numFrames, results);
+    MatchFrames(results);
+    return results;
+}
+
+vector<BatchFrame> BatchProcessor::Process(FrameSource& source)
+{
+    vector<BatchFrame> results(source.NumFrames());
+    DescribeFrames(&source, nullptr, 0, results);
+    MatchFrames(results);
+    return results;
+}
+
+// Detect and describe all frames, either of the array or read from the source. Workers take the
+// next frame when they are done with the last one.
+void BatchProcessor::DescribeFrames(FrameSource* source, const cv::Mat* frames, size_t numFrames, vector<BatchFrame>& results)
+{
+    ScopedTimer timer("batch describe");
+    SingleThreadedOpencv singleThreaded(NumWorkers());
+    atomic<size_t> nextFrame(0);
+    mutex mtx; // guards the source and the size of results
+    size_t numRead = 0;
+
+    vector<thread> workers;
+    for (int w = 0; w < NumWorkers(); w++)
+    {
+        workers.emplace_back([&]() {
+            auto detector = CreateDetector(params_m);
+            auto descriptor = CreateDescriptor(params_m.descriptorType);
+            auto staticPipeline = params_m.bStaticPipeline ? CreateStaticPipeline(params_m) : nullptr;
+            if (detector == nullptr)
+                return;
+
+            while (true)
+            {
+                SourceFrame item;
+                if (source)
+                {
+                    lock_guard<mutex> lock(mtx);
+                    if (!source->Next(item))
+                        break;
+                    item.index = numRead++; // the source counts from its first frame, results from 0
+                    if (results.size() <= item.index)
+                        results.resize(item.index + 1);
+                }
+                else
+                {
+                    item.index = nextFrame++;
+                    if (item.index >= numFrames)
+                        break;
+                    item.imgGray = frames[item.index];
+                }
+
+                StageTimes times;
+                DataFrame frame = staticPipeline ? staticPipeline->DetectAndDescribe(item.imgGray, &times)
+                                                 : DetectAndDescribeFeatures(item.imgGray, detector, descriptor, params_m, &times);
+
+                // results may be resized by a worker reading the source at the same time
+                unique_lock<mutex> lock(mtx, defer_lock);
+                if (source)
+                    lock.lock();
+                BatchFrame& result = results[item.index];
+                result.index = item.index;
+                result.features = std::move(frame.features);
+                result.times.detect = times.detect;
+                result.times.describe = times.describe;
+            }
+        });
+    }
+    for (auto& th : workers)
+        th.join();
+
+    // the source may have ended before the frame count it announced
+    if (source)
+        results.resize(numRead);
+    FT_LOG_INFO("Described " << results.size() << " frames in " << 1000 * timer.Elapsed() << " ms");
+}
+
+// Match every frame against its predecessor. The workers take chunks of consecutive pairs, each
+// worker keeps one matcher for all its chunks.
+void BatchProcessor::MatchFrames(vector<BatchFrame>& results)
+{
+    if (results.size() < 2)
+        return;
+
+    ScopedTimer timer("batch match");
+    SingleThreadedOpencv singleThreaded(NumWorkers());
+    const size_t numPairs = results.size() - 1;
+    atomic<size_t> nextPair(0);
+
+    vector<thread> workers;
+    for (int w = 0; w < NumWorkers(); w++)
+    {
+        workers.emplace_back([&]() {
+            FeatureTracker matcher(params_m);
+            for (size_t begin = nextPair.fetch_add(kPairsPerChunk); begin < numPairs; begin = nextPair.fetch_add(kPairsPerChunk))
+            {
+                matcher.ResetSequence(); // the chunk doesn't continue the last one of this worker
+                const size_t end = min(numPairs, begin + kPairsPerChunk);
+                for (size_t pair = begin; pair < end; pair++)
+                {
+                    BatchFrame& current = results[pair + 1];
+                    ScopedTimer pairTimer("match pair", &current.times.match);
+                    current.matches = matcher.MatchFrames(results[pair].features, current.features);
+                    FT_COUNTER("matches", current.matches.size());
+                }
+            }
+        });
+    }
+    for (auto& th : workers)
+        th.join();
+
+    FT_LOG_INFO("Matched " << numPairs << " frame pairs in " << 1000 * timer.Elapsed() << " ms");
+}
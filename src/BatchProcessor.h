@@ -0,0 +1,49 @@
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+
+#include <vector>
+
+#include "dataStructures.h" // Params, StageTimes
+#include "FeatureStore.h"
+#include "FrameSource.h"
+
+struct BatchFrame
+{
+    size_t index = 0;
+    FeatureStore features;
+    std::vector<cv::DMatch> matches; // previous frame (queryIdx) to this frame (trainIdx), empty for the first frame
+    StageTimes times;                // detect, describe and match time of this frame
+};
+
+// Offline processing of a whole sequence for throughput instead of latency. All frames are
+// detected and described in parallel first, then the pairs (i, i+1) are matched in parallel.
+// Each worker thread owns its detector, descriptor and matcher.
+//
+// Pairs are matched in chunks of consecutive pairs, each worker keeps its matcher for all its
+// chunks. Incremental flann only carries over within a chunk, the first pair of a chunk builds
+// a new index. The motion prior of gated matching is carried over from the last chunk of the
+// worker. opencv runs single threaded inside the workers.
+class BatchProcessor
+{
+public:
+    BatchProcessor(const Params& params);
+
+    // the frames are only read, results are in the order of the frames
+    std::vector<BatchFrame> Process(const cv::Mat* frames, size_t numFrames);
+    std::vector<BatchFrame> Process(const std::vector<cv::Mat>& frames) { return Process(frames.data(), frames.size()); }
+
+    // reads the source to its end, frames are dropped as soon as they are described
+    std::vector<BatchFrame> Process(FrameSource& source);
+
+private:
+    int NumWorkers() const;
+    void DescribeFrames(FrameSource* source, const cv::Mat* frames, size_t numFrames, std::vector<BatchFrame>& results);
+    void MatchFrames(std::vector<BatchFrame>& results);
+
+    Params params_m;
+};
+
+#endif /* BATCHPROCESSOR_H */
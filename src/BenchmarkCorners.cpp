@@ -0,0 +1,154 @@
+/* Comparison of the corner detectors with their reference implementations on KITTI images */
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <functional>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/features2d.hpp>
+
+#include "matching2D.hpp"
+
+using namespace std;
+
+/* INIT VARIABLES AND DATA STRUCTURES */
+// data location
+string dataPath = "../";
+// camera
+string imgBasePath = dataPath + "images/";
+string imgPrefix = "KITTI/2011_09_26/image_00/data/000000"; // left camera, color
+string imgFileType = ".png";
+int imgStartIndex = 0; // first file index to load
+int imgEndIndex = 9;   // last file index to load
+int imgFillWidth = 4;  // no. of digits which make up the file index (e.g. img-0001.png)
+
+const int cornerBudgetLimited = 500; // below the corners of a KITTI image, so the budget is binding
+
+typedef function<vector<cv::KeyPoint>(const cv::Mat&)> DetectFunction;
+
+// Harris keypoints as they were found before the max filter: every pixel above the threshold is
+// compared with all keypoints so far in raster order and replaces the first weaker one it overlaps
+vector<cv::KeyPoint> ReferenceHarris(const cv::Mat& img)
+{
+    const int blockSize = 2, apertureSize = 3, minResponse = 100;
+    const double k = 0.04, maxOverlap = 0.0;
+    cv::Mat dst, dst_norm;
+    cv::cornerHarris(img, dst, blockSize, apertureSize, k);
+    cv::normalize(dst, dst_norm, 0, 255, cv::NORM_MINMAX, CV_32FC1, cv::Mat());
+
+    vector<cv::KeyPoint> keypoints;
+    for (int j = 0; j < dst_norm.rows; j++)
+    {
+        for (int i = 0; i < dst_norm.cols; i++)
+        {
+            int response = (int)dst_norm.at<float>(j, i);
+            if (response <= minResponse)
+                continue;
+            cv::KeyPoint newKeyPoint(cv::Point2f(i, j), 2 * apertureSize, -1, response);
+            bool bOverlap = false;
+            for (auto& kpt : keypoints)
+            {
+                if (cv::KeyPoint::overlap(newKeyPoint, kpt) > maxOverlap)
+                {
+                    bOverlap = true;
+                    if (newKeyPoint.response > kpt.response)
+                    {
+                        kpt = newKeyPoint;
+                        break;
+                    }
+                }
+            }
+            if (!bOverlap)
+                keypoints.push_back(newKeyPoint);
+        }
+    }
+    return keypoints;
+}
+
+// no. of keypoints of a with a keypoint of b less than tolerance pixels away
+int CountFound(const vector<cv::KeyPoint>& a, const vector<cv::KeyPoint>& b, float tolerance)
+{
+    int numFound = 0;
+    for (const auto& p : a)
+    {
+        for (const auto& q : b)
+        {
+            const cv::Point2f d = p.pt - q.pt;
+            if (d.x * d.x + d.y * d.y < tolerance * tolerance)
+            {
+                numFound++;
+                break;
+            }
+        }
+    }
+    return numFound;
+}
+
+void CompareDetector(const string& name, const DetectFunction& reference, const DetectFunction& detector,
+                     float tolerance, const vector<cv::Mat>& images)
+{
+    double tReference = 0.0, tDetector = 0.0;
+    int numReference = 0, numDetector = 0, numReferenceFound = 0, numDetectorFound = 0;
+    for (const auto& img : images)
+    {
+        double t = (double)cv::getTickCount();
+        vector<cv::KeyPoint> referenceKpts = reference(img);
+        tReference += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+        t = (double)cv::getTickCount();
+        vector<cv::KeyPoint> detectorKpts = detector(img);
+        tDetector += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+        numReference += referenceKpts.size();
+        numDetector += detectorKpts.size();
+        numReferenceFound += CountFound(referenceKpts, detectorKpts, tolerance);
+        numDetectorFound += CountFound(detectorKpts, referenceKpts, tolerance);
+    }
+
+    cout << name << "\n";
+    cout << "  reference : " << numReference << " keypoints, " << 1000 * tReference / images.size() << " ms per image" << "\n";
+    cout << "  detector  : " << numDetector << " keypoints, " << 1000 * tDetector / images.size() << " ms per image" << "\n";
+    cout << "  " << numReferenceFound << " of " << numReference << " reference and " << numDetectorFound << " of "
+         << numDetector << " detector keypoints have a counterpart within " << tolerance << " px" << "\n";
+}
+
+int main(int argc, const char *argv[])
+{
+    vector<cv::Mat> images;
+    for (size_t imgIndex = 0; imgIndex <= imgEndIndex - imgStartIndex; imgIndex++)
+    {
+        ostringstream imgNumber;
+        imgNumber << setfill('0') << setw(imgFillWidth) << imgStartIndex + imgIndex;
+        string imgFullFilename = imgBasePath + imgPrefix + imgNumber.str() + imgFileType;
+
+        cv::Mat img, imgGray;
+        img = cv::imread(imgFullFilename);
+        cv::cvtColor(img, imgGray, cv::COLOR_BGR2GRAY);
+        images.push_back(imgGray);
+    }
+
+    // the max filter NMS resolves overlaps by strength instead of raster order, a few keypoints
+    // move to a stronger neighbour
+    DetectorHarris harris(0, false);
+    CompareDetector("HARRIS max filter NMS vs. raster order NMS", ReferenceHarris,
+                    [&](const cv::Mat& img) { return harris.DetectKeypoints(img); }, 1.f, images);
+
+    // the native kernels have to find the keypoints of the opencv functions, with and without a
+    // corner budget
+    for (int cornerBudget : {0, cornerBudgetLimited})
+    {
+        const string budget = " (cornerBudget " + to_string(cornerBudget) + ")";
+        DetectorHarris harrisOpencv(cornerBudget, false), harrisNative(cornerBudget, true);
+        CompareDetector("HARRIS native vs. cornerHarris + normalize" + budget,
+                        [&](const cv::Mat& img) { return harrisOpencv.DetectKeypoints(img); },
+                        [&](const cv::Mat& img) { return harrisNative.DetectKeypoints(img); }, 0.5f, images);
+        DetectorShiTomasi shiTomasiOpencv(cornerBudget, false), shiTomasiNative(cornerBudget, true);
+        CompareDetector("SHITOMASI native vs. goodFeaturesToTrack" + budget,
+                        [&](const cv::Mat& img) { return shiTomasiOpencv.DetectKeypoints(img); },
+                        [&](const cv::Mat& img) { return shiTomasiNative.DetectKeypoints(img); }, 0.5f, images);
+    }
+    return 0;
+}
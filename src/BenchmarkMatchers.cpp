@@ -0,0 +1,101 @@
+/* Microbenchmark of the native hamming matcher against opencv's brute force matcher on KITTI descriptors */
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/features2d.hpp>
+
+#include "HammingMatcher.h"
+
+using namespace std;
+
+/* INIT VARIABLES AND DATA STRUCTURES */
+// data location
+string dataPath = "../";
+// camera
+string imgBasePath = dataPath + "images/";
+string imgPrefix = "KITTI/2011_09_26/image_00/data/000000"; // left camera, color
+string imgFileType = ".png";
+int imgStartIndex = 0; // first file index to load
+int imgEndIndex = 9;   // last file index to load
+int imgFillWidth = 4;  // no. of digits which make up the file index (e.g. img-0001.png)
+
+const int numRepetitions = 20;
+
+void BenchmarkDescriptor(const string& name, const cv::Ptr<cv::Feature2D>& extractor, const vector<cv::Mat>& images)
+{
+    // describe all images once, the benchmark only measures matching
+    vector<cv::Mat> descriptors;
+    for (const auto& img : images)
+    {
+        vector<cv::KeyPoint> keypoints;
+        cv::Mat desc;
+        extractor->detectAndCompute(img, cv::noArray(), keypoints, desc);
+        descriptors.push_back(desc);
+    }
+
+    cv::Ptr<cv::BFMatcher> bfMatcher = cv::BFMatcher::create(cv::NORM_HAMMING, false);
+    HammingMatcher hammingMatcher;
+
+    double tBf = 0.0, tHamming = 0.0;
+    int numMismatches = 0, numQueries = 0;
+    for (int rep = 0; rep < numRepetitions; rep++)
+    {
+        for (size_t i = 1; i < descriptors.size(); i++)
+        {
+            vector<vector<cv::DMatch>> knnMatches;
+            double t = (double)cv::getTickCount();
+            bfMatcher->knnMatch(descriptors[i - 1], descriptors[i], knnMatches, 2);
+            tBf += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+            vector<Best2Match> best2;
+            t = (double)cv::getTickCount();
+            hammingMatcher.KnnMatch2(descriptors[i - 1], descriptors[i], best2);
+            tHamming += ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+            // the best distances have to agree, indices may differ on ties
+            if (rep == 0)
+            {
+                for (size_t q = 0; q < knnMatches.size(); q++)
+                {
+                    numQueries++;
+                    if (knnMatches[q].empty() || (int)knnMatches[q][0].distance != best2[q].distance[0])
+                        numMismatches++;
+                }
+            }
+        }
+    }
+
+    int numPairs = numRepetitions * (descriptors.size() - 1);
+    cout << name << " (" << descriptors[0].rows << " x " << descriptors[0].cols << " bytes)" << "\n";
+    cout << "  BFMatcher knnMatch : " << 1000 * tBf / numPairs << " ms per frame pair" << "\n";
+    cout << "  HammingMatcher     : " << 1000 * tHamming / numPairs << " ms per frame pair ("
+         << HammingMatcher::InstructionSet() << ")" << "\n";
+    cout << "  speedup            : " << tBf / max(tHamming, 1e-12) << "x, "
+         << numMismatches << " of " << numQueries << " best distances differ" << "\n";
+}
+
+int main(int argc, const char *argv[])
+{
+    vector<cv::Mat> images;
+    for (size_t imgIndex = 0; imgIndex <= imgEndIndex - imgStartIndex; imgIndex++)
+    {
+        ostringstream imgNumber;
+        imgNumber << setfill('0') << setw(imgFillWidth) << imgStartIndex + imgIndex;
+        string imgFullFilename = imgBasePath + imgPrefix + imgNumber.str() + imgFileType;
+
+        cv::Mat img, imgGray;
+        img = cv::imread(imgFullFilename);
+        cv::cvtColor(img, imgGray, cv::COLOR_BGR2GRAY);
+        images.push_back(imgGray);
+    }
+
+    BenchmarkDescriptor("ORB", cv::ORB::create(5000), images);
+    BenchmarkDescriptor("BRISK", cv::BRISK::create(), images);
+    BenchmarkDescriptor("AKAZE", cv::AKAZE::create(), images);
+    return 0;
+}
@@ -0,0 +1,94 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <algorithm>
+
+struct QueueStats
+{
+    size_t capacity = 0;
+    size_t maxSize = 0;     // highest occupancy seen at a push
+    double meanSize = 0.0;  // average occupancy seen at a push
+};
+
+// Blocking FIFO with a fixed capacity, used to hand work between pipeline stages.
+// Push blocks while the queue is full, Pop blocks while it is empty. Once Close()
+// has been called Pop drains the remaining items and then returns false.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_m(std::max<size_t>(capacity, 1)) {}
+
+    bool Push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_m);
+        notFull_m.wait(lock, [this] { return closed_m || items_m.size() < capacity_m; });
+        if (closed_m)
+            return false;
+        items_m.push_back(std::move(item));
+        numPushes_m++;
+        sizeSum_m += items_m.size();
+        maxSize_m = std::max(maxSize_m, items_m.size());
+        lock.unlock();
+        notEmpty_m.notify_one();
+        return true;
+    }
+
+    bool Pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_m);
+        notEmpty_m.wait(lock, [this] { return closed_m || !items_m.empty(); });
+        if (items_m.empty())
+            return false; // closed and drained
+        item = std::move(items_m.front());
+        items_m.pop_front();
+        lock.unlock();
+        notFull_m.notify_one();
+        return true;
+    }
+
+    // no more items will be pushed, wake up everybody waiting on the queue
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_m);
+            closed_m = true;
+        }
+        notEmpty_m.notify_all();
+        notFull_m.notify_all();
+    }
+
+    size_t Size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        return items_m.size();
+    }
+
+    QueueStats GetStats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        QueueStats stats;
+        stats.capacity = capacity_m;
+        stats.maxSize = maxSize_m;
+        stats.meanSize = numPushes_m > 0 ? (double)sizeSum_m / numPushes_m : 0.0;
+        return stats;
+    }
+
+private:
+    const size_t capacity_m;
+    std::deque<T> items_m;
+    bool closed_m = false;
+
+    size_t numPushes_m = 0;
+    size_t sizeSum_m = 0;
+    size_t maxSize_m = 0;
+
+    mutable std::mutex mutex_m;
+    std::condition_variable notEmpty_m;
+    std::condition_variable notFull_m;
+};
+
+#endif /* BOUNDEDQUEUE_H */
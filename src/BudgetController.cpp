@@ -0,0 +1,46 @@
+#include "BudgetController.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Instrumentation.h"
+
+using namespace std;
+
+namespace
+{
+
+const double kHeadroom = 0.9;  // aim below the target, so noise doesn't push frames over it
+const double kMinScale = 0.5;  // largest cut per frame
+const double kMaxScale = 1.2;  // largest increase per frame
+const double kDeadband = 0.05; // changes below 5% are skipped
+
+} // namespace
+
+
+BudgetController::BudgetController(const Params& params)
+    : targetMs_m(params.latencyTargetMs), minBudget_m(max(1, params.budgetMin)), maxBudget_m(max(minBudget_m, params.budgetMax)),
+      budget_m(maxBudget_m)
+{
+}
+
+void BudgetController::Update(const StageTimes& times, size_t numKeypoints, KPDetector& detector)
+{
+    if (!Enabled())
+        return;
+
+    const double frameMs = 1000 * (times.detect + times.describe + times.match);
+    const double scale = min(kMaxScale, max(kMinScale, kHeadroom * targetMs_m / max(frameMs, 1e-3)));
+    if (abs(scale - 1.0) < kDeadband)
+        return;
+
+    // the budget limited this frame if it has as many keypoints as the budget allows
+    const bool bBudgetLimited = numKeypoints >= (size_t)budget_m;
+    const bool bDetectionBound = times.detect > times.describe + times.match;
+    if (scale < 1.0 ? (bDetectionBound || !bBudgetLimited) : !bBudgetLimited)
+        detector.AdjustSensitivity(scale);
+
+    budget_m = min(maxBudget_m, max(minBudget_m, (int)lround(budget_m * scale)));
+    FT_COUNTER("keypoint budget", budget_m);
+    FT_LOG_DEBUG("Frame took " << frameMs << " ms of " << targetMs_m << " ms, keypoint budget " << budget_m);
+}
@@ -0,0 +1,33 @@
+#ifndef BUDGETCONTROLLER_H
+#define BUDGETCONTROLLER_H
+
+#include <cstddef>
+
+#include "dataStructures.h" // Params, StageTimes
+#include "matching2D.hpp" // KPDetector
+
+// Closed loop control of the per frame work to hold latencyTargetMs. After every frame the
+// keypoint budget (maxKeypoints) is scaled by the ratio of target to measured time: cut by up to
+// half at once when a frame is too slow, grown by at most 20% when there is headroom, so dense
+// frames are caught immediately and the budget recovers without oscillating. The budget only
+// saves description and matching, so the detector threshold is adjusted too when detection
+// takes most of the time, or when the detector finds fewer keypoints than the budget allows.
+class BudgetController
+{
+public:
+    BudgetController(const Params& params);
+
+    bool Enabled() const { return targetMs_m > 0.0; }
+    int Budget() const { return budget_m; }
+
+    // numKeypoints is the no. of keypoints of the frame after the budget was applied
+    void Update(const StageTimes& times, size_t numKeypoints, KPDetector& detector);
+
+private:
+    double targetMs_m;
+    int minBudget_m;
+    int maxBudget_m;
+    int budget_m;
+};
+
+#endif /* BUDGETCONTROLLER_H */
@@ -0,0 +1,202 @@
+#include "CompactMatcher.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+
+// no. of bytes of train descriptors processed per block, chosen to stay in the L1 cache
+const int kTrainBlockBytes = 16 * 1024;
+
+inline float HalfToFloat(uint16_t h)
+{
+    const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0x1f) // inf, nan
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else if (exponent != 0)
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    else if (mantissa == 0)
+        bits = sign;
+    else
+    {
+        // subnormal, normalized in float
+        exponent = 113;
+        while (!(mantissa & 0x400))
+        {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    float f;
+    memcpy(&f, &bits, 4);
+    return f;
+}
+
+#if defined(__AVX2__)
+inline int HorizontalSum(__m256i v)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+inline float HorizontalSum(__m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+#endif
+
+inline int L2SqrU8Impl(const uint8_t* a, const uint8_t* b, int n)
+{
+    int i = 0;
+    int dist = 0;
+#if defined(__AVX2__)
+    // |a - b| from two saturating subtractions, widened to 16 bit and squared and summed in pairs
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i d = _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va));
+        __m256i lo = _mm256_unpacklo_epi8(d, zero);
+        __m256i hi = _mm256_unpackhi_epi8(d, zero);
+        acc = _mm256_add_epi32(acc, _mm256_add_epi32(_mm256_madd_epi16(lo, lo), _mm256_madd_epi16(hi, hi)));
+    }
+    dist = HorizontalSum(acc);
+#endif
+    for (; i < n; i++)
+    {
+        const int d = (int)a[i] - (int)b[i];
+        dist += d * d;
+    }
+    return dist;
+}
+
+inline float L2SqrFp16Impl(const uint16_t* a, const uint16_t* b, int n)
+{
+    int i = 0;
+    float dist = 0.f;
+#if defined(__AVX2__) && defined(__F16C__)
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 va = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(a + i)));
+        __m256 vb = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(b + i)));
+        __m256 d = _mm256_sub_ps(va, vb);
+#if defined(__FMA__)
+        acc = _mm256_fmadd_ps(d, d, acc);
+#else
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(d, d));
+#endif
+    }
+    dist = HorizontalSum(acc);
+#endif
+    for (; i < n; i++)
+    {
+        const float d = HalfToFloat(a[i]) - HalfToFloat(b[i]);
+        dist += d * d;
+    }
+    return dist;
+}
+
+inline void UpdateBest2(Best2MatchL2& m, int trainIdx, float distSqr)
+{
+    if (distSqr < m.distSqr[0])
+    {
+        m.distSqr[1] = m.distSqr[0];
+        m.trainIdx[1] = m.trainIdx[0];
+        m.distSqr[0] = distSqr;
+        m.trainIdx[0] = trainIdx;
+    }
+    else if (distSqr < m.distSqr[1])
+    {
+        m.distSqr[1] = distSqr;
+        m.trainIdx[1] = trainIdx;
+    }
+}
+
+// queries [queryBegin, queryEnd) against all train rows, T is the element type of the rows
+template <typename T, typename DistanceFn>
+void L2Best2(const cv::Mat& query, int queryBegin, int queryEnd, const cv::Mat& train,
+             DistanceFn distance, Best2MatchL2* matches)
+{
+    const int n = query.cols;
+    const int blockRows = max(1, kTrainBlockBytes / max(1, n * (int)sizeof(T)));
+    for (int q = queryBegin; q < queryEnd; q++)
+        matches[q] = Best2MatchL2();
+
+    // keep one block of train descriptors hot in the cache while all queries run over it
+    for (int blockBegin = 0; blockBegin < train.rows; blockBegin += blockRows)
+    {
+        const int blockEnd = min(train.rows, blockBegin + blockRows);
+        for (int q = queryBegin; q < queryEnd; q++)
+        {
+            const T* qDesc = query.ptr<T>(q);
+            Best2MatchL2& m = matches[q];
+            for (int t = blockBegin; t < blockEnd; t++)
+                UpdateBest2(m, t, (float)distance(qDesc, train.ptr<T>(t), n));
+        }
+    }
+}
+
+} // namespace
+
+
+int L2SqrU8(const uint8_t* a, const uint8_t* b, int n)
+{
+    return L2SqrU8Impl(a, b, n);
+}
+
+float L2SqrFp16(const uint16_t* a, const uint16_t* b, int n)
+{
+    return L2SqrFp16Impl(a, b, n);
+}
+
+void CompactMatcher::KnnMatch2(const cv::Mat& queryDesc, const cv::Mat& trainDesc, vector<Best2MatchL2>& matches) const
+{
+    CV_Assert(queryDesc.type() == trainDesc.type() || queryDesc.empty() || trainDesc.empty());
+    CV_Assert(queryDesc.empty() || trainDesc.empty() || queryDesc.cols == trainDesc.cols);
+
+    matches.resize(queryDesc.rows);
+    if (queryDesc.empty() || trainDesc.empty())
+        return;
+    CV_Assert(queryDesc.type() == CV_8UC1 || queryDesc.type() == CV_16SC1);
+
+    // queries are independent, split them into stripes which run on opencv's thread pool
+    const bool bHalf = queryDesc.depth() == CV_16S;
+    cv::parallel_for_(cv::Range(0, queryDesc.rows), [&](const cv::Range& range) {
+        if (bHalf)
+            L2Best2<uint16_t>(queryDesc, range.start, range.end, trainDesc,
+                              [](const uint16_t* a, const uint16_t* b, int n) { return L2SqrFp16Impl(a, b, n); }, matches.data());
+        else
+            L2Best2<uint8_t>(queryDesc, range.start, range.end, trainDesc,
+                             [](const uint8_t* a, const uint8_t* b, int n) { return L2SqrU8Impl(a, b, n); }, matches.data());
+    });
+}
+
+const char* CompactMatcher::InstructionSet()
+{
+#if defined(__AVX2__) && defined(__F16C__)
+    return "AVX2 F16C";
+#elif defined(__AVX2__)
+    return "AVX2 (scalar half floats)";
+#else
+    return "scalar";
+#endif
+}
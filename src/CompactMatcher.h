@@ -0,0 +1,34 @@
+#ifndef COMPACTMATCHER_H
+#define COMPACTMATCHER_H
+
+#include <opencv2/core.hpp>
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+// best and second best match of one query under the squared L2 distance
+struct Best2MatchL2
+{
+    int trainIdx[2] = {-1, -1};
+    float distSqr[2] = {FLT_MAX, FLT_MAX};
+};
+
+// Brute force L2 matcher for the compact descriptors of DescriptorCompressor: 8 bit (CV_8U) or
+// half float (CV_16S) rows. The distances are computed on the compact rows directly, with AVX2
+// (and F16C for half floats) if the compiler targets it, so only a quarter or half of the bytes
+// of float descriptors are streamed. Train descriptors are processed in blocks which fit into
+// the L1 cache, the two best matches of every query are found in one pass.
+class CompactMatcher
+{
+public:
+    void KnnMatch2(const cv::Mat& queryDesc, const cv::Mat& trainDesc, std::vector<Best2MatchL2>& matches) const;
+
+    static const char* InstructionSet();
+};
+
+// squared L2 distance between two descriptors of n values
+int L2SqrU8(const uint8_t* a, const uint8_t* b, int n);
+float L2SqrFp16(const uint16_t* a, const uint16_t* b, int n);
+
+#endif /* COMPACTMATCHER_H */
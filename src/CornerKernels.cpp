@@ -0,0 +1,406 @@
+#include "CornerKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+
+// rows per parallel task, the product rows and box sums of a strip stay in the L2 cache
+const int kStripRows = 32;
+
+// index into [0, n) with opencv's BORDER_REFLECT_101
+inline int Reflect101(int i, int n)
+{
+    if (n == 1)
+        return 0;
+    while (i < 0 || i >= n) // a box window may be larger than the image
+        i = i < 0 ? -i : 2 * n - 2 - i;
+    return i;
+}
+
+#if defined(__AVX2__)
+inline __m256i Load8(const uint8_t* p)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p));
+}
+#endif
+
+// 3x3 Sobel gradients of one row and their products, p, c and n are the rows above, at and below
+void GradientProducts(const uint8_t* p, const uint8_t* c, const uint8_t* n, int width,
+                      int32_t* xx, int32_t* xy, int32_t* yy)
+{
+    auto pixel = [&](int x) {
+        const int l = Reflect101(x - 1, width), r = Reflect101(x + 1, width);
+        const int dx = (p[r] - p[l]) + 2 * (c[r] - c[l]) + (n[r] - n[l]);
+        const int dy = (n[l] + 2 * n[x] + n[r]) - (p[l] + 2 * p[x] + p[r]);
+        xx[x] = dx * dx;
+        xy[x] = dx * dy;
+        yy[x] = dy * dy;
+    };
+
+    pixel(0);
+    int x = 1;
+#if defined(__AVX2__)
+    for (; x + 9 <= width; x += 8) // the loads reach up to x + 8
+    {
+        const __m256i pl = Load8(p + x - 1), pc = Load8(p + x), pr = Load8(p + x + 1);
+        const __m256i cl = Load8(c + x - 1), cr = Load8(c + x + 1);
+        const __m256i nl = Load8(n + x - 1), nc = Load8(n + x), nr = Load8(n + x + 1);
+        const __m256i dx = _mm256_add_epi32(_mm256_add_epi32(_mm256_sub_epi32(pr, pl), _mm256_sub_epi32(nr, nl)),
+                                            _mm256_slli_epi32(_mm256_sub_epi32(cr, cl), 1));
+        const __m256i dy = _mm256_add_epi32(_mm256_sub_epi32(_mm256_add_epi32(nl, nr), _mm256_add_epi32(pl, pr)),
+                                            _mm256_slli_epi32(_mm256_sub_epi32(nc, pc), 1));
+        _mm256_storeu_si256((__m256i*)(xx + x), _mm256_mullo_epi32(dx, dx));
+        _mm256_storeu_si256((__m256i*)(xy + x), _mm256_mullo_epi32(dx, dy));
+        _mm256_storeu_si256((__m256i*)(yy + x), _mm256_mullo_epi32(dy, dy));
+    }
+#endif
+    for (; x < width; x++)
+        pixel(x);
+}
+
+// acc += sign * row
+void AccumulateRow(int32_t* acc, const int32_t* row, int n, bool bSubtract)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256i a = _mm256_loadu_si256((const __m256i*)(acc + i));
+        const __m256i r = _mm256_loadu_si256((const __m256i*)(row + i));
+        _mm256_storeu_si256((__m256i*)(acc + i), bSubtract ? _mm256_sub_epi32(a, r) : _mm256_add_epi32(a, r));
+    }
+#endif
+    for (; i < n; i++)
+        acc[i] += bSubtract ? -row[i] : row[i];
+}
+
+// horizontal box sum of blockSize columns, padded holds the row with its reflected border
+void BoxRow(const int32_t* padded, int width, int blockSize, int32_t* boxed)
+{
+    int x = 0;
+#if defined(__AVX2__)
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i sum = _mm256_loadu_si256((const __m256i*)(padded + x));
+        for (int i = 1; i < blockSize; i++)
+            sum = _mm256_add_epi32(sum, _mm256_loadu_si256((const __m256i*)(padded + x + i)));
+        _mm256_storeu_si256((__m256i*)(boxed + x), sum);
+    }
+#endif
+    for (; x < width; x++)
+    {
+        int32_t sum = 0;
+        for (int i = 0; i < blockSize; i++)
+            sum += padded[x + i];
+        boxed[x] = sum;
+    }
+}
+
+// response of one row from the box summed structure tensor, min and max are updated
+void ResponseRow(const int32_t* sxx, const int32_t* sxy, const int32_t* syy, int width, CornerResponseType type,
+                 float k, float scale2, float* response, float& minVal, float& maxVal)
+{
+    auto pixel = [&](int x) {
+        const float a = sxx[x] * scale2, b = sxy[x] * scale2, c = syy[x] * scale2;
+        float r;
+        if (type == CornerResponseType::MinEigenVal)
+            r = (a + c) * 0.5f - sqrt((a - c) * (a - c) * 0.25f + b * b);
+        else
+            r = a * c - b * b - k * (a + c) * (a + c);
+        response[x] = r;
+        minVal = min(minVal, r);
+        maxVal = max(maxVal, r);
+    };
+
+    int x = 0;
+#if defined(__AVX2__)
+    const __m256 vScale = _mm256_set1_ps(scale2);
+    const __m256 vHalf = _mm256_set1_ps(0.5f), vQuarter = _mm256_set1_ps(0.25f), vK = _mm256_set1_ps(k);
+    __m256 vMin = _mm256_set1_ps(minVal), vMax = _mm256_set1_ps(maxVal);
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m256 a = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(sxx + x))), vScale);
+        const __m256 b = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(sxy + x))), vScale);
+        const __m256 c = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(syy + x))), vScale);
+        const __m256 sum = _mm256_add_ps(a, c);
+        __m256 r;
+        if (type == CornerResponseType::MinEigenVal)
+        {
+            const __m256 diff = _mm256_sub_ps(a, c);
+            const __m256 disc = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(diff, diff), vQuarter), _mm256_mul_ps(b, b));
+            r = _mm256_sub_ps(_mm256_mul_ps(sum, vHalf), _mm256_sqrt_ps(disc));
+        }
+        else
+        {
+            r = _mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(a, c), _mm256_mul_ps(b, b)), _mm256_mul_ps(vK, _mm256_mul_ps(sum, sum)));
+        }
+        _mm256_storeu_ps(response + x, r);
+        vMin = _mm256_min_ps(vMin, r);
+        vMax = _mm256_max_ps(vMax, r);
+    }
+    float lanes[8];
+    _mm256_storeu_ps(lanes, vMin);
+    minVal = *min_element(lanes, lanes + 8);
+    _mm256_storeu_ps(lanes, vMax);
+    maxVal = *max_element(lanes, lanes + 8);
+#endif
+    for (; x < width; x++)
+        pixel(x);
+}
+
+// Response of rows [y0, y1). The gradient products of the blockSize rows of the box window are
+// kept in a ring, their column sums are updated by one row in and one row out per output row.
+void ResponseStrip(const cv::Mat& img, int y0, int y1, int blockSize, CornerResponseType type, float k, float scale2,
+                   cv::Mat& response, float& minVal, float& maxVal)
+{
+    const int width = img.cols, height = img.rows;
+    const int anchor = blockSize / 2; // box window of row y is [y - anchor, y - anchor + blockSize), as cv::boxFilter
+    const int paddedWidth = width + blockSize - 1;
+
+    vector<int32_t> products(3 * blockSize * width);
+    vector<int32_t> sums(3 * paddedWidth, 0); // column sums of xx, xy, yy with a reflected border
+    vector<int32_t> boxed(3 * width);
+
+    auto productRow = [&](int r, int slot) {
+        const int row = Reflect101(r, height);
+        int32_t* dst = &products[3 * slot * width];
+        GradientProducts(img.ptr<uint8_t>(Reflect101(row - 1, height)), img.ptr<uint8_t>(row),
+                         img.ptr<uint8_t>(Reflect101(row + 1, height)), width, dst, dst + width, dst + 2 * width);
+    };
+    auto accumulate = [&](int slot, bool bSubtract) {
+        const int32_t* src = &products[3 * slot * width];
+        for (int ch = 0; ch < 3; ch++)
+            AccumulateRow(&sums[ch * paddedWidth + anchor], src + ch * width, width, bSubtract);
+    };
+
+    for (int i = 0; i < blockSize; i++)
+    {
+        productRow(y0 - anchor + i, i);
+        accumulate(i, false);
+    }
+
+    minVal = numeric_limits<float>::max();
+    maxVal = numeric_limits<float>::lowest();
+    for (int y = y0; y < y1; y++)
+    {
+        if (y > y0)
+        {
+            // the row leaving the window and the one entering it share a slot
+            const int slot = (y - 1 - y0) % blockSize;
+            accumulate(slot, true);
+            productRow(y - anchor + blockSize - 1, slot);
+            accumulate(slot, false);
+        }
+
+        for (int ch = 0; ch < 3; ch++)
+        {
+            int32_t* padded = &sums[ch * paddedWidth];
+            for (int j = 0; j < anchor; j++)
+                padded[j] = padded[anchor + Reflect101(j - anchor, width)];
+            for (int j = anchor + width; j < paddedWidth; j++)
+                padded[j] = padded[anchor + Reflect101(j - anchor, width)];
+            BoxRow(padded, width, blockSize, &boxed[ch * width]);
+        }
+        ResponseRow(&boxed[0], &boxed[width], &boxed[2 * width], width, type, k, scale2, response.ptr<float>(y), minVal, maxVal);
+    }
+}
+
+// max of the row over the window [x - radius, x + radius], clipped at the row ends
+void HorizontalMax(const float* row, int cols, int radius, float* out)
+{
+    auto pixel = [&](int x) {
+        float m = row[x];
+        for (int xx = max(0, x - radius); xx <= min(cols - 1, x + radius); xx++)
+            m = max(m, row[xx]);
+        out[x] = m;
+    };
+
+    int x = 0;
+    for (; x < min(cols, radius); x++)
+        pixel(x);
+#if defined(__AVX2__)
+    for (; x + radius + 8 <= cols; x += 8)
+    {
+        __m256 m = _mm256_loadu_ps(row + x - radius);
+        for (int i = 1; i <= 2 * radius; i++)
+            m = _mm256_max_ps(m, _mm256_loadu_ps(row + x - radius + i));
+        _mm256_storeu_ps(out + x, m);
+    }
+#endif
+    for (; x < cols; x++)
+        pixel(x);
+}
+
+// element wise max of n rows
+void VerticalMax(const float* const* rows, int n, int cols, float* out)
+{
+    int x = 0;
+#if defined(__AVX2__)
+    for (; x + 8 <= cols; x += 8)
+    {
+        __m256 m = _mm256_loadu_ps(rows[0] + x);
+        for (int i = 1; i < n; i++)
+            m = _mm256_max_ps(m, _mm256_loadu_ps(rows[i] + x));
+        _mm256_storeu_ps(out + x, m);
+    }
+#endif
+    for (; x < cols; x++)
+    {
+        float m = rows[0][x];
+        for (int i = 1; i < n; i++)
+            m = max(m, rows[i][x]);
+        out[x] = m;
+    }
+}
+
+// heap ordered by StrongerCorner, the weakest corner kept is at the front
+void PushBounded(vector<Corner>& heap, const Corner& corner, size_t capacity)
+{
+    if (capacity == 0)
+    {
+        heap.push_back(corner);
+    }
+    else if (heap.size() < capacity)
+    {
+        heap.push_back(corner);
+        push_heap(heap.begin(), heap.end(), StrongerCorner);
+    }
+    else if (StrongerCorner(corner, heap.front()))
+    {
+        pop_heap(heap.begin(), heap.end(), StrongerCorner);
+        heap.back() = corner;
+        push_heap(heap.begin(), heap.end(), StrongerCorner);
+    }
+}
+
+} // namespace
+
+
+void CornerResponseMap(const cv::Mat& img, int blockSize, CornerResponseType type, double k,
+                       cv::Mat& response, float& minVal, float& maxVal)
+{
+    CV_Assert(img.type() == CV_8UC1 && blockSize >= 1 && blockSize <= 45);
+    response.create(img.size(), CV_32F);
+    minVal = maxVal = 0.f;
+    if (img.empty())
+        return;
+
+    // normalization of cv::cornerEigenValsVecs for an 8 bit image and a 3x3 Sobel
+    const double scale = 1.0 / (4.0 * blockSize * 255.0);
+    const int numStrips = (img.rows + kStripRows - 1) / kStripRows;
+    vector<float> stripMin(numStrips), stripMax(numStrips);
+    cv::parallel_for_(cv::Range(0, numStrips), [&](const cv::Range& range) {
+        for (int s = range.start; s < range.end; s++)
+            ResponseStrip(img, s * kStripRows, min(img.rows, (s + 1) * kStripRows), blockSize, type, (float)k,
+                          (float)(scale * scale), response, stripMin[s], stripMax[s]);
+    });
+    minVal = *min_element(stripMin.begin(), stripMin.end());
+    maxVal = *max_element(stripMax.begin(), stripMax.end());
+}
+
+vector<Corner> SelectCorners(const cv::Mat& response, float minResponse, int radius, int border, size_t capacity)
+{
+    CV_Assert(response.type() == CV_32FC1 && response.isContinuous());
+    const int rows = response.rows, cols = response.cols;
+    const float* data = response.ptr<float>(0);
+    const int numStrips = (rows + kStripRows - 1) / kStripRows;
+    vector<vector<Corner>> stripCorners(numStrips);
+
+    // A pixel is a local maximum if it equals the max of its window. The window max is separable,
+    // the row maxima of a strip and its halo are kept in a buffer and reduced row by row.
+    cv::parallel_for_(cv::Range(0, numStrips), [&](const cv::Range& range) {
+        vector<float> rowMax, windowMax(cols);
+        vector<const float*> windowRows;
+        for (int s = range.start; s < range.end; s++)
+        {
+            const int y0 = max(border, s * kStripRows), y1 = min(rows - border, (s + 1) * kStripRows);
+            if (y0 >= y1)
+                continue;
+            const int haloBegin = max(0, y0 - radius), haloEnd = min(rows, y1 + radius);
+            rowMax.resize((size_t)(haloEnd - haloBegin) * cols);
+            for (int y = haloBegin; y < haloEnd; y++)
+                HorizontalMax(data + (size_t)y * cols, cols, radius, &rowMax[(size_t)(y - haloBegin) * cols]);
+
+            vector<Corner>& heap = stripCorners[s];
+            const int xEnd = cols - border;
+            for (int y = y0; y < y1; y++)
+            {
+                windowRows.clear();
+                for (int yy = max(haloBegin, y - radius); yy <= min(haloEnd - 1, y + radius); yy++)
+                    windowRows.push_back(&rowMax[(size_t)(yy - haloBegin) * cols]);
+                VerticalMax(windowRows.data(), (int)windowRows.size(), cols, windowMax.data());
+
+                const float* row = data + (size_t)y * cols;
+                const float* localMax = windowMax.data();
+                int x = border;
+#if defined(__AVX2__)
+                // most pixels are below the threshold or not a maximum, they are skipped eight at a time
+                const __m256 threshold = _mm256_set1_ps(minResponse);
+                for (; x + 8 <= xEnd; x += 8)
+                {
+                    const __m256 value = _mm256_loadu_ps(row + x);
+                    int mask = _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(value, threshold, _CMP_GE_OQ),
+                                                                _mm256_cmp_ps(value, _mm256_loadu_ps(localMax + x), _CMP_GE_OQ)));
+                    while (mask)
+                    {
+                        const int i = x + __builtin_ctz(mask);
+                        PushBounded(heap, Corner{row[i], i, y}, capacity);
+                        mask &= mask - 1;
+                    }
+                }
+#endif
+                for (; x < xEnd; x++)
+                    if (row[x] >= minResponse && row[x] >= localMax[x])
+                        PushBounded(heap, Corner{row[x], x, y}, capacity);
+            }
+        }
+    });
+
+    vector<Corner> corners;
+    for (const auto& strip : stripCorners)
+        corners.insert(corners.end(), strip.begin(), strip.end());
+    sort(corners.begin(), corners.end(), StrongerCorner);
+    if (capacity > 0 && corners.size() > capacity)
+        corners.resize(capacity);
+    return corners;
+}
+
+void KeepDiskMaxima(const cv::Mat& response, float maxDistance, vector<Corner>& corners)
+{
+    CV_Assert(response.type() == CV_32FC1);
+    // offsets of the disk, without the center
+    const int radius = (int)ceil(maxDistance) - 1;
+    vector<cv::Point> offsets;
+    for (int dy = -radius; dy <= radius; dy++)
+        for (int dx = -radius; dx <= radius; dx++)
+            if ((dx != 0 || dy != 0) && dx * dx + dy * dy < maxDistance * maxDistance)
+                offsets.emplace_back(dx, dy);
+
+    size_t numKept = 0;
+    for (const auto& c : corners)
+    {
+        bool bMax = true;
+        for (const auto& o : offsets)
+        {
+            const int x = c.x + o.x, y = c.y + o.y;
+            if (x >= 0 && y >= 0 && x < response.cols && y < response.rows && response.at<float>(y, x) > c.response)
+            {
+                bMax = false;
+                break;
+            }
+        }
+        if (bMax)
+            corners[numKept++] = c;
+    }
+    corners.resize(numKept);
+}
@@ -0,0 +1,49 @@
+#ifndef CORNERKERNELS_H
+#define CORNERKERNELS_H
+
+#include <opencv2/core.hpp>
+
+#include <cstddef>
+#include <vector>
+
+enum class CornerResponseType
+{
+    MinEigenVal, // Shi-Tomasi, as cv::cornerMinEigenVal
+    Harris       // as cv::cornerHarris
+};
+
+// candidate corner, a local maximum of the response
+struct Corner
+{
+    float response;
+    int x;
+    int y;
+};
+
+// stronger response first, raster order among equal responses
+inline bool StrongerCorner(const Corner& a, const Corner& b)
+{
+    if (a.response != b.response)
+        return a.response > b.response;
+    return a.y != b.y ? a.y < b.y : a.x < b.x;
+}
+
+// Corner response of an 8 bit image with a 3x3 Sobel and a blockSize box window, the same values as
+// cv::cornerMinEigenVal / cv::cornerHarris up to float rounding. Gradients, structure tensor and
+// response are computed in one pass over strips of rows, the products and box sums of a strip
+// stay in the cache and only the response is written. The structure tensor is summed in
+// integers, so blockSize is at most 45. minVal and maxVal are the extremes of the response.
+void CornerResponseMap(const cv::Mat& img, int blockSize, CornerResponseType type, double k,
+                       cv::Mat& response, float& minVal, float& maxVal);
+
+// Responses >= minResponse which are the maximum of their (2 * radius + 1)^2 window (ties are
+// kept, the window is clipped at the image border), without the outer border pixels. Only the
+// capacity strongest are kept in bounded heaps while the strips are scanned, 0 keeps all.
+// The corners are sorted with StrongerCorner.
+std::vector<Corner> SelectCorners(const cv::Mat& response, float minResponse, int radius, int border, size_t capacity);
+
+// Keeps the corners which are the maximum of the response at all pixels less than maxDistance
+// away (ties are kept, the disk is clipped at the image border), in their order
+void KeepDiskMaxima(const cv::Mat& response, float maxDistance, std::vector<Corner>& corners);
+
+#endif /* CORNERKERNELS_H */
@@ -0,0 +1,143 @@
+#include "DescriptorCompression.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#include "Instrumentation.h"
+#include "matching2D.hpp" // KPDetector
+#include "util.h" // DetectAndDescribeFeatures
+
+using namespace std;
+
+namespace
+{
+
+// every PCA file is read once, failures are kept as nullptr so they are reported once
+shared_ptr<const DescriptorPca> LoadPca(const string& filename)
+{
+    static mutex cacheMutex;
+    static map<string, shared_ptr<const DescriptorPca>> cache;
+    lock_guard<mutex> lock(cacheMutex);
+    auto it = cache.find(filename);
+    if (it != cache.end())
+        return it->second;
+
+    shared_ptr<DescriptorPca> pca;
+    cv::FileStorage fs(filename, cv::FileStorage::READ);
+    if (fs.isOpened())
+    {
+        pca = make_shared<DescriptorPca>();
+        double scale = 1.0;
+        fs["mean"] >> pca->pca.mean;
+        fs["eigenvectors"] >> pca->pca.eigenvectors;
+        fs["eigenvalues"] >> pca->pca.eigenvalues;
+        fs["scale"] >> scale;
+        pca->scale = (float)scale;
+        if (pca->pca.mean.empty() || pca->pca.mean.rows != 1 || pca->pca.eigenvectors.cols != pca->pca.mean.cols)
+        {
+            FT_LOG_ERROR("Invalid descriptor PCA in " << filename << ", descriptors are not projected");
+            pca = nullptr;
+        }
+        else
+            FT_LOG_INFO("Projecting descriptors onto " << pca->pca.eigenvectors.rows << " of " << pca->pca.mean.cols
+                        << " dimensions with the PCA of " << filename);
+    }
+    else
+        FT_LOG_ERROR("Unable to read the descriptor PCA " << filename << ", descriptors are not projected");
+
+    cache[filename] = pca;
+    return pca;
+}
+
+} // namespace
+
+
+DescriptorCompressor::DescriptorCompressor(const Params& params)
+{
+    bEnabled_m = CompactDescriptors(params);
+    bHalf_m = params.descCompression == "FP16";
+    if (bEnabled_m && !params.descPcaFile.empty())
+        pca_m = LoadPca(params.descPcaFile);
+}
+
+void DescriptorCompressor::Compress(cv::Mat& descriptors) const
+{
+    if (!bEnabled_m || descriptors.empty() || descriptors.depth() != CV_32F)
+        return;
+
+    cv::Mat values = descriptors;
+    double scale = 1.0, offset = 0.0;
+    if (pca_m)
+    {
+        CV_Assert(descriptors.cols == pca_m->pca.mean.cols);
+        pca_m->pca.project(descriptors, values);
+        // projected values are centered, 8 bit values around 128
+        scale = pca_m->scale;
+        offset = 128.0;
+    }
+
+    cv::Mat compact;
+    if (bHalf_m)
+        cv::convertFp16(values, compact);
+    else
+        values.convertTo(compact, CV_8U, scale, offset);
+    descriptors = compact;
+}
+
+bool CompactDescriptors(const Params& params)
+{
+    // SIFT is the only float descriptor, the others are binary already
+    return (params.descCompression == "U8" || params.descCompression == "FP16") && params.descriptorType == "SIFT";
+}
+
+bool LearnDescriptorPca(FrameSource& source, const Params& params)
+{
+    if (params.descPcaFile.empty())
+    {
+        FT_LOG_ERROR("descPcaFile is needed to learn a descriptor PCA!");
+        return false;
+    }
+
+    Params learnParams = params;
+    learnParams.descCompression = "NONE";
+    auto detector = CreateDetector(learnParams);
+    auto descriptor = CreateDescriptor(learnParams.descriptorType);
+    if (detector == nullptr || descriptor.empty())
+        return false;
+
+    cv::Mat samples;
+    SourceFrame frame;
+    while (source.Next(frame))
+    {
+        DataFrame described = DetectAndDescribeFeatures(frame.imgGray, detector, descriptor, learnParams);
+        samples.push_back(described.features.descriptors()); // copied out of the frame arena
+    }
+    if (samples.empty() || samples.depth() != CV_32F || samples.rows < params.descPcaDims)
+    {
+        FT_LOG_ERROR("A descriptor PCA needs at least descPcaDims float descriptors, " << params.descriptorType
+                     << " gave " << samples.rows);
+        return false;
+    }
+
+    DescriptorPca result;
+    const int dims = min(params.descPcaDims, samples.cols);
+    result.pca = cv::PCA(samples, cv::noArray(), cv::PCA::DATA_AS_ROW, dims);
+
+    // the largest projected value of the samples is quantized to 127, none of them is clipped
+    double minVal, maxVal;
+    cv::minMaxLoc(result.pca.project(samples), &minVal, &maxVal);
+    result.scale = (float)(127.0 / max(1e-6, max(-minVal, maxVal)));
+
+    cv::FileStorage fs(params.descPcaFile, cv::FileStorage::WRITE);
+    if (!fs.isOpened())
+    {
+        FT_LOG_ERROR("Unable to write the descriptor PCA " << params.descPcaFile);
+        return false;
+    }
+    fs << "mean" << result.pca.mean << "eigenvectors" << result.pca.eigenvectors
+       << "eigenvalues" << result.pca.eigenvalues << "scale" << (double)result.scale;
+    FT_LOG_INFO("Learned a PCA with " << dims << " of " << samples.cols << " dimensions from " << samples.rows
+                << " descriptors, written to " << params.descPcaFile);
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef DESCRIPTORCOMPRESSION_H
+#define DESCRIPTORCOMPRESSION_H
+
+#include <opencv2/core.hpp>
+
+#include <memory>
+#include <string>
+
+#include "dataStructures.h" // Params
+#include "FrameSource.h"
+
+// PCA projection of float descriptors with the quantization scale of the projected values.
+// Stored with cv::FileStorage as "mean" (1 x n), "eigenvectors" (one component per row),
+// "eigenvalues" and "scale".
+struct DescriptorPca
+{
+    cv::PCA pca;
+    float scale = 1.f; // U8: a projected value v is stored as scale * v + 128
+};
+
+// Keeps float descriptors (SIFT) in a compact form in the frames and for the matcher: optionally
+// projected onto the components of a PCA learned offline (descPcaFile), then quantized to
+// 8 bit (descCompression U8, CV_8U) or to half floats (FP16, CV_16S holding the bits as
+// cv::convertFp16 does). Without PCA both are exact for opencv's SIFT, whose values are integers
+// in [0, 255]. Compact descriptors are matched under L2 with CompactMatcher.
+// Constructing it is cheap, a PCA file is read once per process.
+class DescriptorCompressor
+{
+public:
+    explicit DescriptorCompressor(const Params& params);
+
+    bool Enabled() const { return bEnabled_m; }
+
+    // replaces float descriptors by their compact form, other descriptors stay as they are
+    void Compress(cv::Mat& descriptors) const;
+
+    // PCA the descriptors are projected onto, nullptr without descPcaFile or if it can't be read
+    const DescriptorPca* Pca() const { return pca_m.get(); }
+
+private:
+    bool bEnabled_m = false;
+    bool bHalf_m = false;
+    std::shared_ptr<const DescriptorPca> pca_m; // nullptr without descPcaFile
+};
+
+// true if the settings store the descriptors compactly, only float descriptors are compressed
+bool CompactDescriptors(const Params& params);
+
+// Describes the frames of the source without compression, learns the PCA of all descriptors
+// with descPcaDims components and writes it to descPcaFile
+bool LearnDescriptorPca(FrameSource& source, const Params& params);
+
+#endif /* DESCRIPTORCOMPRESSION_H */
@@ -0,0 +1,215 @@
+#include "FeatureCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "DescriptorCompression.h" // CompactDescriptors
+#include "Instrumentation.h"
+
+using namespace std;
+
+namespace
+{
+
+const char kCacheMagic[8] = {'F', 'T', 'F', 'E', 'A', 'T', '1', '\0'};
+const size_t kCacheHeaderBytes = 64; // keeps the arena 64 byte aligned in the mapping
+
+struct CacheHeader
+{
+    char magic[8];
+    uint64_t key;
+    uint64_t numKeypoints;
+    int32_t descCols;
+    int32_t descType;
+    uint64_t arenaBytes;
+};
+
+const uint64_t kFnvOffset = 14695981039346656037ull;
+const uint64_t kFnvPrime = 1099511628211ull;
+
+uint64_t Fnv1a(uint64_t hash, const void* data, size_t n)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < n; i++)
+        hash = (hash ^ p[i]) * kFnvPrime;
+    return hash;
+}
+
+// FNV-1a on 8 byte words, the image rows are hashed 8 times faster than byte by byte
+uint64_t Fnv1aWords(uint64_t hash, const uint8_t* p, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, p + i, 8);
+        hash = (hash ^ word) * kFnvPrime;
+    }
+    return Fnv1a(hash, p + i, n - i);
+}
+
+uint64_t HashString(uint64_t hash, const string& str)
+{
+    return Fnv1a(hash, str.data(), str.size());
+}
+
+// size, type and content of a matrix, row by row
+uint64_t HashMat(uint64_t hash, const cv::Mat& mat)
+{
+    const int size[3] = {mat.rows, mat.cols, mat.type()};
+    hash = Fnv1a(hash, size, sizeof(size));
+    const size_t rowBytes = mat.cols * mat.elemSize();
+    for (int row = 0; row < mat.rows; row++)
+        hash = Fnv1aWords(hash, mat.ptr<uint8_t>(row), rowBytes);
+    return hash;
+}
+
+} // namespace
+
+
+FeatureCache::FeatureCache(const string& dir) : dir_m(dir)
+{
+}
+
+string FeatureCache::Path(uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.ftf", (unsigned long long)key);
+    return dir_m + "/" + name;
+}
+
+bool FeatureCache::Load(uint64_t key, FeatureStore& features) const
+{
+    FT_SCOPED_TIMER("cache load");
+    int fd = open(Path(key).c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    CacheHeader header;
+    bool bValid = fstat(fd, &st) == 0 && (size_t)st.st_size >= kCacheHeaderBytes &&
+                  pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                  memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) == 0 && header.key == key &&
+                  header.arenaBytes == FeatureStore::ArenaBytes(header.numKeypoints, header.descCols, header.descType) &&
+                  (size_t)st.st_size >= kCacheHeaderBytes + header.arenaBytes;
+    if (bValid && header.arenaBytes == 0)
+    {
+        close(fd);
+        features = FeatureStore(); // a frame without keypoints
+        return true;
+    }
+
+    // private mapping: the features may be written to, the file never is
+    void* mapped = bValid ? mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd); // the mapping stays valid
+    if (mapped == MAP_FAILED)
+    {
+        if (!bValid)
+            FT_LOG_WARN("ignoring invalid cache entry " << Path(key));
+        return false;
+    }
+
+    const size_t mappedBytes = st.st_size;
+    uint8_t* base = static_cast<uint8_t*>(mapped);
+    shared_ptr<uint8_t> owner(base, [mappedBytes](uint8_t* p) { munmap(p, mappedBytes); });
+    features = FeatureStore::FromArena(std::move(owner), base + kCacheHeaderBytes, header.numKeypoints, header.descCols, header.descType);
+    FT_COUNTER("cache hits", 1);
+    return true;
+}
+
+void FeatureCache::Store(uint64_t key, const FeatureStore& features) const
+{
+    FT_SCOPED_TIMER("cache store");
+    mkdir(dir_m.c_str(), 0755); // fails harmlessly if it exists
+
+    const cv::Mat& descriptors = features.descriptors();
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.key = key;
+    header.numKeypoints = features.size();
+    header.descCols = descriptors.empty() ? 0 : descriptors.cols;
+    header.descType = descriptors.empty() ? CV_8U : descriptors.type();
+    header.arenaBytes = features.bytes();
+
+    vector<char> headerBytes(kCacheHeaderBytes, 0);
+    memcpy(headerBytes.data(), &header, sizeof(header));
+
+    // written under a name of its own and renamed, readers only ever see complete entries
+    const string path = Path(key);
+    ostringstream tmpPath;
+    tmpPath << path << ".tmp" << getpid() << "_" << hash<thread::id>()(this_thread::get_id());
+    {
+        ofstream out(tmpPath.str(), ios::binary);
+        out.write(headerBytes.data(), headerBytes.size());
+        if (features.bytes() > 0)
+            out.write(reinterpret_cast<const char*>(features.data()), features.bytes());
+        if (!out)
+        {
+            FT_LOG_WARN("unable to write cache entry " << path);
+            out.close();
+            remove(tmpPath.str().c_str());
+            return;
+        }
+    }
+    if (rename(tmpPath.str().c_str(), path.c_str()) != 0)
+        remove(tmpPath.str().c_str());
+}
+
+
+uint64_t HashImage(const cv::Mat& img)
+{
+    FT_SCOPED_TIMER("hash image");
+    return HashMat(kFnvOffset, img);
+}
+
+// Every setting which changes the keypoints of a frame. The version is raised whenever the
+// detectors change in a way that changes their output.
+uint64_t KeyPointCacheKey(uint64_t imageHash, const Params& params)
+{
+    ostringstream settings;
+    settings << "v1;det=" << params.detectorType << ";tiled=" << params.bTiledDetection;
+    if (params.detectorType == "SHITOMASI" || params.detectorType == "HARRIS")
+        settings << ";corners=" << params.cornerBudget << "," << params.bNativeCorners;
+    if (params.bTiledDetection)
+        settings << "," << params.tileRows << "," << params.tileCols << "," << params.tileOverlap << "," << params.tileBudget;
+    settings << ";focus=" << params.bFocusOnVehicle;
+    if (params.bFocusOnVehicle)
+    {
+        for (const auto& rect : params.focusRects)
+            settings << "," << rect.x << "," << rect.y << "," << rect.width << "," << rect.height;
+        settings << ";roi=" << params.bRoiFirst << "," << params.roiPadding;
+    }
+    settings << ";max=" << params.maxKeypoints;
+    return HashString(imageHash, settings.str());
+}
+
+uint64_t FeatureCacheKey(uint64_t keypointKey, const Params& params)
+{
+    const bool bFused = params.bFusedDetectDescribe && params.detectorType == params.descriptorType;
+    string settings = ";desc=" + params.descriptorType + ";fused=" + (bFused ? "1" : "0");
+    if (!CompactDescriptors(params))
+        return HashString(keypointKey, settings);
+
+    // the content of the PCA, so entries projected with the PCA learned before don't match
+    // after descPcaFile is learned again
+    settings += ";compact=" + params.descCompression;
+    uint64_t key = HashString(keypointKey, settings);
+    const DescriptorCompressor compressor(params);
+    if (const DescriptorPca* pca = compressor.Pca())
+    {
+        key = HashMat(key, pca->pca.mean);
+        key = HashMat(key, pca->pca.eigenvectors);
+        key = Fnv1a(key, &pca->scale, sizeof(pca->scale));
+    }
+    return key;
+}
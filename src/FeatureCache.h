@@ -0,0 +1,44 @@
+#ifndef FEATURECACHE_H
+#define FEATURECACHE_H
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <string>
+
+#include "dataStructures.h" // Params
+#include "FeatureStore.h"
+
+// On-disk cache of the features of a frame, one file per entry in the cache directory.
+// A file is a 64 byte header followed by the FeatureStore arena as it is in memory, so an entry
+// is loaded by mapping the file, the store points directly into the mapping. Entries are keyed
+// by a hash of the image content and of every setting which changes the result of the stage:
+// the keypoints of a frame (after focus filter and budget) are kept under a key of the detector
+// settings, keypoints with descriptors under a key which adds the descriptor settings. Runs
+// with another descriptor reuse the detected keypoints, repeated runs skip both stages.
+// Writers use a temporary file which is renamed, so threads and processes can share a directory.
+class FeatureCache
+{
+public:
+    explicit FeatureCache(const std::string& dir); // empty dir disables the cache
+
+    bool Enabled() const { return !dir_m.empty(); }
+
+    // false if there is no valid entry
+    bool Load(uint64_t key, FeatureStore& features) const;
+    void Store(uint64_t key, const FeatureStore& features) const;
+
+private:
+    std::string Path(uint64_t key) const;
+
+    std::string dir_m;
+};
+
+// FNV-1a over the pixels, size and type of the image
+uint64_t HashImage(const cv::Mat& img);
+
+// key of the keypoints of an image and of its keypoints with descriptors
+uint64_t KeyPointCacheKey(uint64_t imageHash, const Params& params);
+uint64_t FeatureCacheKey(uint64_t keypointKey, const Params& params);
+
+#endif /* FEATURECACHE_H */
@@ -0,0 +1,115 @@
+#include "FeatureStore.h"
+
+#include <utility>
+
+using namespace std;
+
+namespace
+{
+
+const size_t kAlignment = 64; // cache line, keeps every array aligned for vector loads
+
+size_t AlignUp(size_t n)
+{
+    return (n + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+} // namespace
+
+
+size_t FeatureStore::ArenaBytes(size_t numKeypoints, int descCols, int descType)
+{
+    const size_t floatBytes = AlignUp(numKeypoints * sizeof(float));
+    const size_t intBytes = AlignUp(numKeypoints * sizeof(int32_t));
+    const size_t descBytes = AlignUp(numKeypoints * descCols * CV_ELEM_SIZE(descType));
+    return 5 * floatBytes + 2 * intBytes + descBytes;
+}
+
+// point the arrays at their place in the arena starting at p
+void FeatureStore::SetLayout(uint8_t* p, size_t numKeypoints, int descCols, int descType)
+{
+    size_m = numKeypoints;
+    bytes_m = ArenaBytes(numKeypoints, descCols, descType);
+    const size_t floatBytes = AlignUp(size_m * sizeof(float));
+    const size_t intBytes = AlignUp(size_m * sizeof(int32_t));
+
+    x_m = reinterpret_cast<float*>(p);
+    y_m = reinterpret_cast<float*>(p + floatBytes);
+    response_m = reinterpret_cast<float*>(p + 2 * floatBytes);
+    kptSize_m = reinterpret_cast<float*>(p + 3 * floatBytes);
+    angle_m = reinterpret_cast<float*>(p + 4 * floatBytes);
+    octave_m = reinterpret_cast<int32_t*>(p + 5 * floatBytes);
+    classId_m = reinterpret_cast<int32_t*>(p + 5 * floatBytes + intBytes);
+    if (size_m > 0 && descCols > 0)
+        descriptors_m = cv::Mat((int)size_m, descCols, descType, p + 5 * floatBytes + 2 * intBytes);
+}
+
+FeatureStore::FeatureStore(const vector<cv::KeyPoint>& keypoints, const cv::Mat& descriptors)
+{
+    // a descriptor per keypoint or no descriptors at all
+    const int descCols = descriptors.empty() ? 0 : descriptors.cols;
+    const int descType = descriptors.empty() ? CV_8U : descriptors.type();
+    const size_t bytes = ArenaBytes(keypoints.size(), descCols, descType);
+    if (bytes == 0)
+        return;
+
+    // one allocation for everything, the extra alignment bytes allow aligning the start
+    arena_m = shared_ptr<uint8_t>(new uint8_t[bytes + kAlignment], default_delete<uint8_t[]>());
+    uint8_t* p = arena_m.get();
+    p += (kAlignment - reinterpret_cast<uintptr_t>(p) % kAlignment) % kAlignment;
+    SetLayout(p, keypoints.size(), descCols, descType);
+
+    for (size_t i = 0; i < size_m; i++)
+    {
+        const cv::KeyPoint& kpt = keypoints[i];
+        x_m[i] = kpt.pt.x;
+        y_m[i] = kpt.pt.y;
+        response_m[i] = kpt.response;
+        kptSize_m[i] = kpt.size;
+        angle_m[i] = kpt.angle;
+        octave_m[i] = kpt.octave;
+        classId_m[i] = kpt.class_id;
+    }
+
+    if (!descriptors_m.empty())
+        descriptors.copyTo(descriptors_m); // same size and type, so the arena is kept
+}
+
+FeatureStore FeatureStore::FromArena(shared_ptr<uint8_t> owner, uint8_t* arena, size_t numKeypoints, int descCols, int descType)
+{
+    FeatureStore store;
+    if (ArenaBytes(numKeypoints, descCols, descType) == 0)
+        return store;
+    store.arena_m = std::move(owner);
+    store.SetLayout(arena, numKeypoints, descCols, descType);
+    return store;
+}
+
+void FeatureStore::swap(FeatureStore& other) noexcept
+{
+    std::swap(arena_m, other.arena_m);
+    std::swap(bytes_m, other.bytes_m);
+    std::swap(size_m, other.size_m);
+    std::swap(x_m, other.x_m);
+    std::swap(y_m, other.y_m);
+    std::swap(response_m, other.response_m);
+    std::swap(kptSize_m, other.kptSize_m);
+    std::swap(angle_m, other.angle_m);
+    std::swap(octave_m, other.octave_m);
+    std::swap(classId_m, other.classId_m);
+    cv::swap(descriptors_m, other.descriptors_m);
+}
+
+cv::KeyPoint FeatureStore::keypoint(size_t i) const
+{
+    return cv::KeyPoint(x_m[i], y_m[i], kptSize_m[i], angle_m[i], response_m[i], octave_m[i], classId_m[i]);
+}
+
+vector<cv::KeyPoint> FeatureStore::ToKeyPoints() const
+{
+    vector<cv::KeyPoint> keypoints;
+    keypoints.reserve(size_m);
+    for (size_t i = 0; i < size_m; i++)
+        keypoints.push_back(keypoint(i));
+    return keypoints;
+}
@@ -0,0 +1,80 @@
+#ifndef FEATURESTORE_H
+#define FEATURESTORE_H
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Keypoints and descriptors of one frame in a single allocation. The keypoint attributes are
+// stored as separate arrays (structure of arrays) so hot loops only touch what they need, the
+// descriptors follow as a dense matrix. cv::KeyPoint vectors are only built on request, for
+// opencv calls which need them.
+class FeatureStore
+{
+public:
+    FeatureStore() {}
+    FeatureStore(const std::vector<cv::KeyPoint>& keypoints, const cv::Mat& descriptors);
+
+    FeatureStore(FeatureStore&& other) noexcept { swap(other); }
+    FeatureStore& operator=(FeatureStore&& other) noexcept
+    {
+        FeatureStore(std::move(other)).swap(*this); // other is left empty, the old arena is released
+        return *this;
+    }
+    FeatureStore(const FeatureStore&) = delete;
+    FeatureStore& operator=(const FeatureStore&) = delete;
+
+    size_t size() const { return size_m; }
+    bool empty() const { return size_m == 0; }
+
+    const float* x() const { return x_m; }
+    const float* y() const { return y_m; }
+    const float* response() const { return response_m; }
+    const float* kptSize() const { return kptSize_m; }
+    const float* angle() const { return angle_m; }
+    const int32_t* octave() const { return octave_m; }
+    const int32_t* classId() const { return classId_m; }
+
+    cv::Point2f pt(size_t i) const { return cv::Point2f(x_m[i], y_m[i]); }
+    cv::KeyPoint keypoint(size_t i) const;
+    std::vector<cv::KeyPoint> ToKeyPoints() const;
+
+    // descriptor matrix, one row per keypoint. The matrix points into the arena and is only
+    // valid as long as the store is alive
+    const cv::Mat& descriptors() const { return descriptors_m; }
+
+    size_t bytes() const { return bytes_m; }
+
+    // The arena as one block of bytes() bytes, 64 byte aligned. Its layout only depends on the
+    // no. of keypoints and the descriptor size and type, so it can be written out as is and
+    // used again with FromArena.
+    const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(x_m); }
+    static size_t ArenaBytes(size_t numKeypoints, int descCols, int descType);
+
+    // store on an arena with the layout above which lives somewhere else, e.g. in a memory
+    // mapped file. arena must be 64 byte aligned, owner keeps it alive
+    static FeatureStore FromArena(std::shared_ptr<uint8_t> owner, uint8_t* arena, size_t numKeypoints, int descCols, int descType);
+
+    void swap(FeatureStore& other) noexcept;
+
+private:
+    void SetLayout(uint8_t* arena, size_t numKeypoints, int descCols, int descType);
+
+    std::shared_ptr<uint8_t> arena_m; // owns all arrays below
+    size_t bytes_m = 0;
+    size_t size_m = 0;
+
+    float* x_m = nullptr;
+    float* y_m = nullptr;
+    float* response_m = nullptr;
+    float* kptSize_m = nullptr;
+    float* angle_m = nullptr;
+    int32_t* octave_m = nullptr;
+    int32_t* classId_m = nullptr;
+    cv::Mat descriptors_m;
+};
+
+#endif /* FEATURESTORE_H */
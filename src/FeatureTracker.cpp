@@ -1,139 +1,527 @@
 #include "FeatureTracker.h"
+#include "DescriptorCompression.h"
+#include "Instrumentation.h"
+#include "MatchSelection.h"
 
 #include <opencv2/highgui/highgui.hpp> // imshow
 #include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/video/tracking.hpp> // calcOpticalFlowPyrLK
 #include <opencv2/features2d.hpp>
 #include <opencv2/xfeatures2d.hpp>
 #include <opencv2/xfeatures2d/nonfree.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 using namespace std;
 
 
 FeatureTracker::FeatureTracker(const Params& params)
+    : dataBuffer_m(std::max(2, params.dataBufferSize)), flannMatcher_m(params), verifier_m(params),
+      tracks_m(params.trackMaxLost, params.trackMaxHistory)
 {
     params_m = params;
+    if (params_m.bStaticPipeline)
+        pipeline_m = CreateStaticPipeline(params_m);
+
+    // the matcher is created once and only gets new train descriptors for every frame
+    bool crossCheck = false;
+    if (params_m.matcherType.compare("MAT_BF") == 0)
+        matcher_m = cv::BFMatcher::create(params_m.normType, crossCheck);
+
+    bCompact_m = CompactDescriptors(params_m);
+    if (params_m.descCompression != "NONE" && !bCompact_m)
+        FT_LOG_WARN("descCompression " << params_m.descCompression << " is ignored, only SIFT descriptors are compressed to U8 or FP16");
 }
 
-void FeatureTracker::AddToRingBuffer(const DataFrame& frame)
+void FeatureTracker::AddToRingBuffer(DataFrame&& frame)
 {
-    dataBuffer_m.push_back(frame);
-    while (dataBuffer_m.size() > dataBufferSize_m)
-        dataBuffer_m.erase(dataBuffer_m.begin());
+    // overwrite the oldest frame in place. Image and feature arena are moved in, the match
+    // vector keeps the storage of the old frame and is refilled by TrackFeatures
+    DataFrame& slot = dataBuffer_m.recycle();
+    slot.cameraImg = std::move(frame.cameraImg);
+    slot.features = std::move(frame.features);
+    slot.pyramid = std::move(frame.pyramid);
+    slot.kptMatches.clear();
 }
 
-std::vector<cv::DMatch> ConvertMatches(std::vector<std::vector<cv::DMatch>>& knnMatches)
+// pyramid of the frame for optical flow, built once and used as next and as previous frame
+void FeatureTracker::BuildPyramid(DataFrame& frame) const
 {
-    std::vector<cv::DMatch> matches;
-    for (auto& kMatches : knnMatches)
-        matches.push_back(kMatches[0]);
+    if (!frame.pyramid.empty())
+        return;
+    FT_SCOPED_TIMER("build pyramid");
+    cv::buildOpticalFlowPyramid(frame.cameraImg, frame.pyramid, cv::Size(params_m.kltWinSize, params_m.kltWinSize), params_m.kltPyrLevels);
+}
 
-    return matches;
+bool FeatureTracker::NeedsKeyframe() const
+{
+    if (!params_m.bKltTracking || dataBuffer_m.empty())
+        return true;
+    return framesSinceKeyframe_m + 1 >= params_m.kltKeyframeInterval ||
+           (int)dataBuffer_m.latest(0).features.size() < params_m.kltMinTracks;
 }
 
-void FilterMatches(std::vector<std::vector<cv::DMatch>>& knnMatches)
+vector<cv::DMatch> FeatureTracker::TrackFeatures(DataFrame&& newFrame)
 {
-    cout << "FilterMatches" << "\n";
-    const double minThresh = 0.8;
-    // for each set of matches, compare best match with second best match
-    cout << "Filtering Matches..." << "\n";
+    AddToRingBuffer(std::move(newFrame));
+    framesSinceKeyframe_m = 0;
+    if (params_m.bKltTracking)
+        BuildPyramid(dataBuffer_m.latest(0));
 
-    int numMatches = knnMatches.size();
-    int matchesFiltered = 0;
-    //for (auto& kMatches : knnMatches)
-    for (auto it = knnMatches.begin(); it != knnMatches.end();)
+    vector<cv::DMatch> matches;
+    if (dataBuffer_m.size() > 1) // wait until at least two images have been processed
     {
-        // delete this match if match is ambiguous (top two distances are too close)
-        auto& matches = *it;
-        double ratio = matches[0].distance / matches[1].distance;
-        if (ratio > minThresh)
-        {
-            matchesFiltered++;
-            it = knnMatches.erase(it);
-        }
-        else
-            it++;
+        DataFrame& currentFrame = dataBuffer_m.latest(0);
+        DataFrame& lastFrame = dataBuffer_m.latest(1);
+        matches = MatchFrames(lastFrame.features, currentFrame.features);
+        FT_LOG_DEBUG("#4 : MATCH KEYPOINT DESCRIPTORS done");
+    }
+
+    FinishFrame(matches);
+
+    return matches;
+}
+
+vector<cv::DMatch> FeatureTracker::MatchFrames(const FeatureStore& source, const FeatureStore& ref)
+{
+    vector<cv::DMatch> matches;
+    {
+        FT_SCOPED_TIMER("match");
+        matches = matchDescriptors(source, ref);
     }
-    cout << "Filtered out " << matchesFiltered << " ambiguous matches out of " << numMatches << " total." << endl;
+    if (params_m.bGeomVerify)
+        VerifyGeometry(source, ref, matches);
+    return matches;
 }
 
+// Robust fit of the frame geometry to the matches, the outliers are removed unless only the
+// inlier mask is asked for. Matches which can't be verified (too few, no model) are kept
+void FeatureTracker::VerifyGeometry(const FeatureStore& source, const FeatureStore& ref, vector<cv::DMatch>& matches)
+{
+    ScopedTimer timer("verify geometry");
+    if (!verifier_m.Verify(source, ref, matches, matchRatios_m, geometry_m))
+    {
+        FT_LOG_DEBUG("Geometric verification of n=" << matches.size() << " matches found no model");
+        return;
+    }
 
+    const size_t numMatches = matches.size();
+    if (params_m.bGeomRemoveOutliers)
+    {
+        size_t numKept = 0;
+        for (size_t i = 0; i < numMatches; i++)
+            if (geometry_m.inlierMask[i])
+                matches[numKept++] = matches[i];
+        matches.resize(numKept);
+    }
+    FT_COUNTER("geometry outliers", numMatches - geometry_m.numInliers);
+    FT_LOG_DEBUG("Geometric verification: " << geometry_m.numInliers << " of " << numMatches << " matches are inliers after "
+                 << geometry_m.iterations << " samples in " << 1000 * timer.Elapsed() << " ms");
+}
 
-vector<cv::DMatch> FeatureTracker::TrackFeatures(const DataFrame& newFrame)
+// Track the keypoints of the last frame into the new image with pyramidal Lucas-Kanade flow.
+// The tracked keypoints keep their descriptors, so the next keyframe is matched against them
+// like against a detected frame.
+vector<cv::DMatch> FeatureTracker::TrackFeatures(const cv::Mat& imgGray)
 {
-    AddToRingBuffer(newFrame);
+    if (dataBuffer_m.empty())
+    {
+        FT_LOG_ERROR("optical flow tracking needs a keyframe first!");
+        return vector<cv::DMatch>();
+    }
 
+    DataFrame newFrame;
+    newFrame.cameraImg = imgGray;
+    BuildPyramid(newFrame);
+
+    DataFrame& lastFrame = dataBuffer_m.latest(0);
+    BuildPyramid(lastFrame); // already there unless the keyframe came in without bKltTracking
+    const FeatureStore& lastFeatures = lastFrame.features;
+    vector<cv::Point2f> prevPts(lastFeatures.size()), nextPts;
+    for (size_t i = 0; i < lastFeatures.size(); i++)
+        prevPts[i] = lastFeatures.pt(i);
+
+    vector<uchar> status;
+    vector<float> err;
     vector<cv::DMatch> matches;
-    if (dataBuffer_m.size() > 1) // wait until at least two images have been processed
     {
-        auto currentFrame = dataBuffer_m.end() - 1;
-        auto lastFrame = dataBuffer_m.end() - 2;
-        matches = matchDescriptors(lastFrame->keypoints, currentFrame->keypoints,
-                                   lastFrame->descriptors, currentFrame->descriptors);
-        
+        ScopedTimer timer("optical flow");
+        if (!prevPts.empty())
+            cv::calcOpticalFlowPyrLK(lastFrame.pyramid, newFrame.pyramid, prevPts, nextPts, status, err,
+                                     cv::Size(params_m.kltWinSize, params_m.kltWinSize), params_m.kltPyrLevels);
+        FT_LOG_DEBUG("KLT tracking of n=" << prevPts.size() << " keypoints in " << 1000 * timer.Elapsed() << " ms");
+    }
+
+    // keep the keypoints which were found inside the image, with the descriptor of their source
+    const cv::Rect2f imageRect(0, 0, imgGray.cols, imgGray.rows);
+    const cv::Mat& lastDescriptors = lastFeatures.descriptors();
+    vector<cv::KeyPoint> keypoints;
+    vector<int> rows;
+    keypoints.reserve(prevPts.size());
+    rows.reserve(prevPts.size());
+    for (size_t i = 0; i < prevPts.size(); i++)
+    {
+        if (!status[i] || !imageRect.contains(nextPts[i]))
+            continue;
+        cv::KeyPoint kpt = lastFeatures.keypoint(i);
+        kpt.pt = nextPts[i];
+        matches.emplace_back(i, keypoints.size(), err[i]);
+        keypoints.push_back(kpt);
+        rows.push_back(i);
+    }
+    cv::Mat descriptors;
+    if (!lastDescriptors.empty())
+    {
+        descriptors.create(rows.size(), lastDescriptors.cols, lastDescriptors.type());
+        for (size_t r = 0; r < rows.size(); r++)
+            lastDescriptors.row(rows[r]).copyTo(descriptors.row(r));
+    }
+    newFrame.features = FeatureStore(keypoints, descriptors);
+
+    // tracked keypoints have no ratio test, the samples are ordered by the flow error
+    matchRatios_m.clear();
+    if (params_m.bGeomVerify)
+        VerifyGeometry(lastFeatures, newFrame.features, matches);
+
+    AddToRingBuffer(std::move(newFrame));
+    framesSinceKeyframe_m++;
+    // the tracked frame is the source of the next match and didn't go through the incremental
+    // flann matcher, so the index of the last keyframe doesn't belong to it
+    flannTrained_m = false;
+    FT_LOG_DEBUG("#4 : KLT TRACKING done, " << matches.size() << " of " << prevPts.size() << " keypoints tracked");
+
+    FinishFrame(matches);
+    return matches;
+}
+
+// store and show the matches of the latest frame and extend the tracks with them
+void FeatureTracker::FinishFrame(const vector<cv::DMatch>& matches)
+{
+    FT_COUNTER("matches", matches.size());
+    if (dataBuffer_m.size() > 1)
+    {
         // store matches in current data frame
-        currentFrame->kptMatches = matches;
-        cout << "#4 : MATCH KEYPOINT DESCRIPTORS done" << endl;
+        dataBuffer_m.latest(0).kptMatches.assign(matches.begin(), matches.end());
         // visualize matches between current and previous image
         if (params_m.visualizeMatches) VisualizeMatches(matches);
     }
 
-    return matches;
+    // the first frame starts a track for every keypoint
+    if (params_m.bTrackHistory)
+    {
+        FT_SCOPED_TIMER("update tracks");
+        tracks_m.Update(dataBuffer_m.latest(0).features, matches);
+        FT_COUNTER("tracks", tracks_m.size());
+    }
 }
 
 
 // Find best matches for keypoints in two camera images based on several matching methods
-std::vector<cv::DMatch> FeatureTracker::matchDescriptors(std::vector<cv::KeyPoint> &kPtsSource,
-                                                         std::vector<cv::KeyPoint> &kPtsRef,
-                                                         cv::Mat &descSource,
-                                                         cv::Mat &descRef)
-                                                         
-{
-    cout << "MatchDescriptors: " << endl;
-    // configure matcher
-    bool crossCheck = false;
-    cv::Ptr<cv::DescriptorMatcher> matcher;
+std::vector<cv::DMatch> FeatureTracker::matchDescriptors(const FeatureStore &source, const FeatureStore &ref)
+{
+    FT_LOG_DEBUG("MatchDescriptors: ");
+    matchRatios_m.clear();
+    if (pipeline_m)
+        return pipeline_m->Match(source, ref, &matchRatios_m);
+    if (params_m.bGatedMatching)
+        return matchDescriptorsGated(source, ref);
 
-    if (params_m.matcherType.compare("MAT_BF") == 0)
-        matcher = cv::BFMatcher::create(params_m.normType, crossCheck);
-    else if (params_m.matcherType.compare("MAT_FLANN") == 0)
+    // headers into the frame arenas
+    const cv::Mat& descSource = source.descriptors();
+    const cv::Mat& descRef = ref.descriptors();
+    if (bCompact_m)
+        return matchDescriptorsCompact(descSource, descRef);
+    if (params_m.matcherType.compare("MAT_HAMMING") == 0)
+        return matchDescriptorsHamming(descSource, descRef);
+    if (params_m.matcherType.compare("MAT_FLANN") == 0)
+        return params_m.bFlannIncremental ? matchDescriptorsFlannIncremental(descSource, descRef) : matchDescriptorsFlann(descSource, descRef);
+
+    if (matcher_m.empty())
+    {
+        FT_LOG_ERROR(params_m.matcherType << " is not a valid matcher type!");
+        return std::vector<cv::DMatch>();
+    }
+
+    const bool bRatioTest = params_m.selectorType.compare("SEL_KNN") == 0;
+    std::vector<cv::DMatch> matches;
+    if (!bRatioTest && params_m.selectorType.compare("SEL_NN") != 0)
+        return matches;
+
+    // for the cross check the source descriptors are the train set first, to get the best
+    // source match of every reference descriptor
+    std::vector<int> reverseBest;
+    if (params_m.bCrossCheck)
+    {
+        std::vector<std::vector<cv::DMatch>> reverseMatches;
+        TrainMatcher(descSource);
+        matcher_m->knnMatch(descRef, reverseMatches, 1);
+        reverseBest = BestTrainIdx(reverseMatches);
+    }
+
+    // train the long-lived matcher on the reference descriptors and query it with the source
+    TrainMatcher(descRef);
+
+    // nearest neighbor (best match) or k nearest neighbors with distance ratio test
+    std::vector<std::vector<cv::DMatch>> knnMatches;
+    {
+        ScopedTimer timer("knn match");
+        matcher_m->knnMatch(descSource, knnMatches, bRatioTest ? 2 : 1);
+        FT_LOG_DEBUG(" (" << (bRatioTest ? "KNN" : "NN") << ") with n=" << knnMatches.size() << " matches in " << 1000 * timer.Elapsed() << " ms");
+    }
+
+    SelectMatches(knnMatches, bRatioTest, params_m.matchRatio, reverseBest, matches, &matchRatios_m);
+
+    // don't keep headers into the frame arena in the matcher
+    matcher_m->clear();
+    return matches;
+}
+
+// replace the train set of the matcher
+void FeatureTracker::TrainMatcher(const cv::Mat &descriptors)
+{
+    matcher_m->clear();
+    matcher_m->add(std::vector<cv::Mat>(1, descriptors));
+    matcher_m->train();
+}
+
+// Approximate matching with a flann index over the reference descriptors, the descriptors are
+// searched in their own type (LSH or hierarchical clustering for binary descriptors, kd-trees for SIFT)
+std::vector<cv::DMatch> FeatureTracker::matchDescriptorsFlann(const cv::Mat &descSource, const cv::Mat &descRef)
+{
+    std::vector<cv::DMatch> matches;
+    const bool bRatioTest = params_m.selectorType.compare("SEL_KNN") == 0;
+    if (!bRatioTest && params_m.selectorType.compare("SEL_NN") != 0)
+        return matches;
+
+    ScopedTimer timer("flann match");
+    std::vector<int> reverseBest;
+    KnnResult knn;
+    if (params_m.bCrossCheck)
+    {
+        flannMatcher_m.Build(descSource);
+        flannMatcher_m.KnnSearch(descRef, 1, knn);
+        reverseBest = BestTrainIdx(knn);
+    }
+
+    flannMatcher_m.Build(descRef);
+    flannMatcher_m.KnnSearch(descSource, bRatioTest ? 2 : 1, knn);
+    SelectMatches(knn, bRatioTest, params_m.matchRatio, reverseBest, matches, &matchRatios_m);
+
+    FT_LOG_DEBUG(" (FLANN) with n=" << matches.size() << " matches in " << 1000 * timer.Elapsed() << " ms");
+    return matches;
+}
+
+// Flann matching where every frame's index is built only once: the index built for the
+// reference frame is kept and queried with the next frame, in which it is the source frame.
+// Query and train indices are swapped afterwards so the matches look like the regular ones.
+std::vector<cv::DMatch> FeatureTracker::matchDescriptorsFlannIncremental(const cv::Mat &descSource, const cv::Mat &descRef)
+{
+    if (!flannTrained_m)
+        flannMatcher_m.Build(descSource);
+
+    ScopedTimer timer("flann incremental match");
+    const bool bRatioTest = params_m.selectorType.compare("SEL_KNN") == 0;
+    KnnResult knn;
+    flannMatcher_m.KnnSearch(descRef, bRatioTest ? 2 : 1, knn);
+
+    // the reference frame is the source frame of the next call
+    flannMatcher_m.Build(descRef);
+    flannTrained_m = true;
+
+    // the queries are reference descriptors here, so the cross check needs the best reference
+    // match of every source descriptor, which the new index answers
+    std::vector<int> reverseBest;
+    if (params_m.bCrossCheck)
     {
-        matcher = cv::DescriptorMatcher::create(cv::DescriptorMatcher::FLANNBASED);
-        // convert descriptors to correct datatype if using flann
-        descSource.convertTo(descSource, CV_32F);
-        descRef.convertTo(descRef, CV_32F);
+        KnnResult reverseKnn;
+        flannMatcher_m.KnnSearch(descSource, 1, reverseKnn);
+        reverseBest = BestTrainIdx(reverseKnn);
     }
 
     std::vector<cv::DMatch> matches;
-    // perform matching task
-    if (params_m.selectorType.compare("SEL_NN") == 0) // nearest neighbor (best match)
-    {
-        matcher->match(descSource, descRef, matches); // Finds the best match for each descriptor in desc1
-    }
-    else if (params_m.selectorType.compare("SEL_KNN") == 0)
-    {
-        cout << "about to run knn matching: " << endl;
-        double t = (double)cv::getTickCount();
-        int k = 2;
-        std::vector<std::vector<cv::DMatch>> knnMatches;
-        cout << "descSource size: " << descSource.size() << "\n";
-        cout << "descRef size: " << descRef.size() << "\n";
-        matcher->knnMatch(descSource, descRef, knnMatches, k);
-        t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
-        cout << " (KNN) with n=" << knnMatches.size() << " matches in " << 1000 * t / 1.0 << " ms" << endl;
-        // filter matches using descriptor distance ratio test
-        FilterMatches(knnMatches);
-        matches = ConvertMatches(knnMatches);
+    SelectMatches(knn, bRatioTest, params_m.matchRatio, reverseBest, matches, &matchRatios_m);
+    for (auto& m : matches)
+        std::swap(m.queryIdx, m.trainIdx);
+
+    FT_LOG_DEBUG(" (FLANN incremental) with n=" << matches.size() << " matches in " << 1000 * timer.Elapsed() << " ms");
+    return matches;
+}
+
+// Match binary descriptors with the native popcount matcher, the knn selector gets the
+// two best matches from the same pass and filters them without building knn lists
+std::vector<cv::DMatch> FeatureTracker::matchDescriptorsHamming(const cv::Mat &descSource, const cv::Mat &descRef)
+{
+    if (descSource.depth() != CV_8U || descRef.depth() != CV_8U)
+    {
+        FT_LOG_ERROR("MAT_HAMMING needs binary descriptors, " << params_m.descriptorType << " is not binary!");
+        return std::vector<cv::DMatch>();
     }
+
+    std::vector<cv::DMatch> matches;
+    ScopedTimer timer("hamming match");
+    const bool bRatioTest = params_m.selectorType.compare("SEL_KNN") == 0;
+    std::vector<int> reverseBest;
+    if (params_m.bCrossCheck)
+    {
+        std::vector<Best2Match> reverseBest2;
+        hammingMatcher_m.KnnMatch2(descRef, descSource, reverseBest2);
+        reverseBest = BestTrainIdx(reverseBest2);
+    }
+
+    std::vector<Best2Match> best2;
+    hammingMatcher_m.KnnMatch2(descSource, descRef, best2);
+    SelectMatches(best2, bRatioTest, params_m.matchRatio, reverseBest, matches, &matchRatios_m);
+    FT_LOG_DEBUG(" (" << HammingMatcher::InstructionSet() << " HAMMING) with n=" << matches.size() << " matches in " << 1000 * timer.Elapsed() << " ms");
+    return matches;
+}
+
+// Match compact descriptors (descCompression) under L2 on their 8 bit or half float rows. It
+// replaces the configured matcher, opencv's matchers would take 8 bit rows as binary descriptors
+std::vector<cv::DMatch> FeatureTracker::matchDescriptorsCompact(const cv::Mat &descSource, const cv::Mat &descRef)
+{
+    std::vector<cv::DMatch> matches;
+    ScopedTimer timer("compact match");
+    const bool bRatioTest = params_m.selectorType.compare("SEL_KNN") == 0;
+    std::vector<int> reverseBest;
+    if (params_m.bCrossCheck)
+    {
+        std::vector<Best2MatchL2> reverseBest2;
+        compactMatcher_m.KnnMatch2(descRef, descSource, reverseBest2);
+        reverseBest = BestTrainIdx(reverseBest2);
+    }
+
+    std::vector<Best2MatchL2> best2;
+    compactMatcher_m.KnnMatch2(descSource, descRef, best2);
+    SelectMatches(best2, bRatioTest, params_m.matchRatio, reverseBest, matches, &matchRatios_m);
+    FT_LOG_DEBUG(" (" << CompactMatcher::InstructionSet() << " " << params_m.descCompression << ") with n=" << matches.size()
+                 << " matches in " << 1000 * timer.Elapsed() << " ms");
+    return matches;
+}
+
+// distance between row i of a and row j of b using the configured norm
+float DescriptorDistance(const cv::Mat& a, int i, const cv::Mat& b, int j, int normType)
+{
+    if (a.depth() == CV_8U && (normType == cv::NORM_HAMMING || normType == cv::NORM_HAMMING2))
+        return HammingDistance(a.ptr<uint8_t>(i), b.ptr<uint8_t>(j), a.cols);
+    if (a.depth() == CV_8U && normType == cv::NORM_L2)
+        return std::sqrt((float)L2SqrU8(a.ptr<uint8_t>(i), b.ptr<uint8_t>(j), a.cols));
+    if (a.depth() == CV_16S) // half floats of descCompression FP16, always L2
+        return std::sqrt(L2SqrFp16(a.ptr<uint16_t>(i), b.ptr<uint16_t>(j), a.cols));
+
+    double dist = 0.0;
+    if (a.depth() == CV_32F)
+    {
+        const float* pa = a.ptr<float>(i);
+        const float* pb = b.ptr<float>(j);
+        for (int k = 0; k < a.cols; k++)
+        {
+            float d = pa[k] - pb[k];
+            dist += normType == cv::NORM_L1 ? std::abs(d) : d * d;
+        }
+    }
+    else
+    {
+        const uint8_t* pa = a.ptr<uint8_t>(i);
+        const uint8_t* pb = b.ptr<uint8_t>(j);
+        for (int k = 0; k < a.cols; k++)
+        {
+            int d = (int)pa[k] - (int)pb[k];
+            dist += normType == cv::NORM_L1 ? std::abs(d) : d * d;
+        }
+    }
+    return normType == cv::NORM_L1 ? (float)dist : (float)std::sqrt(dist);
+}
+
+// median of the keypoint motion between source and reference over all matches
+cv::Point2f MedianFlow(const FeatureStore &source, const FeatureStore &ref, const std::vector<cv::DMatch> &matches)
+{
+    std::vector<float> dx, dy;
+    dx.reserve(matches.size());
+    dy.reserve(matches.size());
+    for (const auto& m : matches)
+    {
+        dx.push_back(ref.x()[m.trainIdx] - source.x()[m.queryIdx]);
+        dy.push_back(ref.y()[m.trainIdx] - source.y()[m.queryIdx]);
+    }
+    std::nth_element(dx.begin(), dx.begin() + dx.size() / 2, dx.end());
+    std::nth_element(dy.begin(), dy.begin() + dy.size() / 2, dy.end());
+    return cv::Point2f(dx[dx.size() / 2], dy[dy.size() / 2]);
+}
+
+// Match each source keypoint only against the reference keypoints within gateRadius of its
+// predicted position. The reference keypoints are put into a grid so the candidates are
+// found without looking at every keypoint.
+std::vector<cv::DMatch> FeatureTracker::matchDescriptorsGated(const FeatureStore &source, const FeatureStore &ref)
+{
+    ScopedTimer timer("gated match");
+    const float radius = params_m.gateRadius;
+    const cv::Point2f flow = params_m.bGateMotionPrior ? flowPrior_m : cv::Point2f(0, 0);
+    const bool bRatioTest = params_m.selectorType.compare("SEL_KNN") == 0;
+    const int normType = bCompact_m ? cv::NORM_L2 : params_m.normType; // compact descriptors are compared under L2
+    const cv::Mat& descSource = source.descriptors();
+    const cv::Mat& descRef = ref.descriptors();
+    refGrid_m.Build(ref.x(), ref.y(), ref.size(), radius);
+
+    // cross check: best source keypoint of every reference keypoint among the source keypoints
+    // whose gate holds it, i.e. within radius of its position moved back by the flow
+    std::vector<int> reverseBest;
+    if (params_m.bCrossCheck)
+    {
+        sourceGrid_m.Build(source.x(), source.y(), source.size(), radius);
+        reverseBest.assign(ref.size(), -1);
+        cv::parallel_for_(cv::Range(0, ref.size()), [&](const cv::Range& range) {
+            for (int j = range.start; j < range.end; j++)
+            {
+                float d0 = std::numeric_limits<float>::max();
+                sourceGrid_m.ForEachInRadius(ref.pt(j) - flow, radius, [&](int i) {
+                    float d = DescriptorDistance(descSource, i, descRef, j, normType);
+                    if (d < d0)
+                    {
+                        d0 = d;
+                        reverseBest[j] = i;
+                    }
+                });
+            }
+        });
+    }
+
+    // two best reference keypoints inside the gate of every source keypoint
+    std::vector<cv::DMatch> matches;
+    auto best2 = [&](int i, int& j0, float& d0, int& j1, float& d1) {
+        d0 = d1 = std::numeric_limits<float>::max();
+        refGrid_m.ForEachInRadius(source.pt(i) + flow, radius, [&](int j) {
+            float d = DescriptorDistance(descSource, i, descRef, j, normType);
+            if (d < d0)
+            {
+                d1 = d0;
+                j1 = j0;
+                d0 = d;
+                j0 = j;
+            }
+            else if (d < d1)
+            {
+                d1 = d;
+                j1 = j;
+            }
+        });
+    };
+    SelectMatches((int)source.size(), best2, bRatioTest, params_m.matchRatio, reverseBest, matches, &matchRatios_m);
+
+    if (params_m.bGateMotionPrior && !matches.empty())
+        flowPrior_m = MedianFlow(source, ref, matches);
+
+    FT_LOG_DEBUG(" (GATED r=" << radius << ") with n=" << matches.size() << " matches in " << 1000 * timer.Elapsed() << " ms");
     return matches;
 }
 
 void FeatureTracker::VisualizeMatches(vector<cv::DMatch> matches)
 {
-    cv::Mat matchImg = ((dataBuffer_m.end() - 1)->cameraImg).clone();
-    cv::drawMatches((dataBuffer_m.end() - 2)->cameraImg, (dataBuffer_m.end() - 2)->keypoints,
-                    (dataBuffer_m.end() - 1)->cameraImg, (dataBuffer_m.end() - 1)->keypoints,
+    cv::Mat matchImg = dataBuffer_m.latest(0).cameraImg.clone();
+    cv::drawMatches(dataBuffer_m.latest(1).cameraImg, dataBuffer_m.latest(1).features.ToKeyPoints(),
+                    dataBuffer_m.latest(0).cameraImg, dataBuffer_m.latest(0).features.ToKeyPoints(),
                     matches, matchImg,
                     cv::Scalar::all(-1), cv::Scalar::all(-1),
                     vector<char>(), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
@@ -141,7 +529,7 @@ void FeatureTracker::VisualizeMatches(vector<cv::DMatch> matches)
     string windowName = "Matching keypoints between two camera images";
     cv::namedWindow(windowName, 7);
     cv::imshow(windowName, matchImg);
-    cout << "Press key to continue to next image" << endl;
+    FT_LOG_INFO("Press key to continue to next image");
     cv::waitKey(params_m.cvWaitTime); // wait for key to be pressed
 }
 
@@ -6,29 +6,87 @@
 #include <opencv2/xfeatures2d.hpp>
 #include <opencv2/xfeatures2d/nonfree.hpp>
 
+#include <memory>
 #include <vector>
 
+#include "CompactMatcher.h"
 #include "dataStructures.h" // DataFrame, Params
+#include "FlannMatcher.h"
+#include "GeometricVerification.h"
+#include "HammingMatcher.h"
+#include "RingBuffer.h"
+#include "SpatialGrid.h"
+#include "StaticPipeline.h"
+#include "TrackManager.h"
 
 class FeatureTracker
 {
 public:
     FeatureTracker(const Params& params);
     
-    std::vector<cv::DMatch> TrackFeatures(const DataFrame& newFrame);
+    std::vector<cv::DMatch> TrackFeatures(DataFrame&& newFrame);
+
+    // bKltTracking: tracks the keypoints of the last frame into the image with optical flow,
+    // without detection and description. The matches have the same form as for a detected frame
+    std::vector<cv::DMatch> TrackFeatures(const cv::Mat& imgGray);
+
+    // true if the next frame has to be detected and described, always true without bKltTracking
+    bool NeedsKeyframe() const;
+
+    // matches from the keypoints of source (queryIdx) to ref (trainIdx) with the configured
+    // matcher. Neither the ring buffer nor the tracks are touched, but the matcher state is:
+    // incremental flann and the motion prior expect consecutive frames from call to call.
+    // bGeomVerify: the matches are verified against a fundamental matrix or homography
+    std::vector<cv::DMatch> MatchFrames(const FeatureStore& source, const FeatureStore& ref);
+
+    // the next MatchFrames pair doesn't continue the last one: the incremental flann index is
+    // dropped. The motion prior is kept as the guess for the new pair
+    void ResetSequence() { flannTrained_m = false; }
+
+    // bGeomVerify: model and inlier mask of the last MatchFrames call, the mask covers the
+    // matches before the outliers were removed
+    const GeometryResult& Geometry() const { return geometry_m; }
+
+    // tracks of all features up to the latest frame
+    const TrackManager& Tracks() const { return tracks_m; }
+
+    // bStaticPipeline: the pipeline which matches the frames, nullptr for the runtime matchers.
+    // Frames for the tracker are detected and described with it, so there is one per run
+    FeaturePipeline* Pipeline() { return pipeline_m.get(); }
 
 private:
-    void AddToRingBuffer(const DataFrame& frame);
+    void AddToRingBuffer(DataFrame&& frame);
     void VisualizeMatches(std::vector<cv::DMatch> matches);
-    std::vector<cv::DMatch> matchDescriptors(std::vector<cv::KeyPoint> &kPtsSource,
-                                             std::vector<cv::KeyPoint> &kPtsRef,
-                                             cv::Mat &descSource,
-                                             cv::Mat &descRef);
+    void BuildPyramid(DataFrame& frame) const;
+    void FinishFrame(const std::vector<cv::DMatch>& matches);
+    std::vector<cv::DMatch> matchDescriptors(const FeatureStore &source, const FeatureStore &ref);
     
-    int dataBufferSize_m = 2;       // no. of images which are held in memory (ring buffer) at the same time
-    std::vector<DataFrame> dataBuffer_m; // list of data frames which are held in memory at the same time
+    void TrainMatcher(const cv::Mat &descriptors);
+    std::vector<cv::DMatch> matchDescriptorsFlann(const cv::Mat &descSource, const cv::Mat &descRef);
+    std::vector<cv::DMatch> matchDescriptorsFlannIncremental(const cv::Mat &descSource, const cv::Mat &descRef);
+    std::vector<cv::DMatch> matchDescriptorsHamming(const cv::Mat &descSource, const cv::Mat &descRef);
+    std::vector<cv::DMatch> matchDescriptorsCompact(const cv::Mat &descSource, const cv::Mat &descRef);
+    std::vector<cv::DMatch> matchDescriptorsGated(const FeatureStore &source, const FeatureStore &ref);
+    void VerifyGeometry(const FeatureStore &source, const FeatureStore &ref, std::vector<cv::DMatch> &matches);
+
+    RingBuffer<DataFrame> dataBuffer_m; // data frames which are held in memory at the same time
 
     Params params_m;
+    cv::Ptr<cv::DescriptorMatcher> matcher_m; // MAT_BF matcher, reused for every frame
+    FlannMatcher flannMatcher_m;  // MAT_FLANN index, with bFlannIncremental the one of the last reference frame
+    bool flannTrained_m = false; // flann index of the latest frame in the buffer is available
+    HammingMatcher hammingMatcher_m;
+    CompactMatcher compactMatcher_m;
+    bool bCompact_m = false;   // descCompression: the frames hold compact descriptors, matched by compactMatcher_m
+    std::vector<float> matchRatios_m; // ratio test margin of the last matches, empty if the matcher doesn't report it
+    GeometricVerifier verifier_m;
+    GeometryResult geometry_m;
+    SpatialGrid refGrid_m;     // grid over the reference keypoints for gated matching
+    SpatialGrid sourceGrid_m;  // grid over the source keypoints for the cross check of gated matching
+    cv::Point2f flowPrior_m;   // median keypoint motion between the last two frames
+    TrackManager tracks_m;
+    std::unique_ptr<FeaturePipeline> pipeline_m; // bStaticPipeline: matcher of the combination, nullptr for the runtime matchers
+    int framesSinceKeyframe_m = 0;
 };
 
 
@@ -0,0 +1,99 @@
+#include "FlannMatcher.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Instrumentation.h"
+
+using namespace std;
+
+namespace
+{
+
+const int kQueriesPerChunk = 64; // queries searched by one parallel task
+const int kBranching = 32;       // hierarchical clustering: no. of clusters per node
+const int kLeafSize = 100;       // hierarchical clustering: max. no. of descriptors in a leaf
+
+} // namespace
+
+
+FlannMatcher::FlannMatcher(const Params& params)
+    : binaryIndex_m(params.flannBinaryIndex), trees_m(max(1, params.flannTrees)), checks_m(max(1, params.flannChecks)),
+      lshTables_m(params.flannLshTables), lshKeySize_m(params.flannLshKeySize), lshProbes_m(params.flannLshProbes)
+{
+}
+
+void FlannMatcher::Build(const cv::Mat& trainDesc)
+{
+    FT_SCOPED_TIMER("flann build");
+    index_m.release();
+    train_m.release();
+    if (trainDesc.empty())
+        return;
+    if (trainDesc.depth() != CV_8U && trainDesc.depth() != CV_32F)
+    {
+        FT_LOG_ERROR("MAT_FLANN needs binary (CV_8U) or float (CV_32F) descriptors");
+        return;
+    }
+
+    // own copy, the descriptors of a frame live in its arena which is recycled with the frame
+    train_m = trainDesc.clone();
+    bBinary_m = train_m.depth() == CV_8U;
+    if (!bBinary_m)
+        index_m = cv::makePtr<cv::flann::Index>(train_m, cv::flann::KDTreeIndexParams(trees_m), cvflann::FLANN_DIST_L2);
+    else if (binaryIndex_m == "HIERARCHICAL")
+        index_m = cv::makePtr<cv::flann::Index>(
+            train_m, cv::flann::HierarchicalClusteringIndexParams(kBranching, cvflann::FLANN_CENTERS_RANDOM, trees_m, kLeafSize),
+            cvflann::FLANN_DIST_HAMMING);
+    else
+        index_m = cv::makePtr<cv::flann::Index>(train_m, cv::flann::LshIndexParams(lshTables_m, lshKeySize_m, lshProbes_m),
+                                                cvflann::FLANN_DIST_HAMMING);
+}
+
+void FlannMatcher::KnnSearch(const cv::Mat& queryDesc, int k, KnnResult& result) const
+{
+    const int numQueries = queryDesc.rows;
+    result.indices.create(numQueries, k, CV_32S);
+    result.distances.create(numQueries, k, CV_32F);
+    result.indices.setTo(-1);
+    result.distances.setTo(0);
+    if (numQueries == 0 || Empty())
+        return;
+    if (queryDesc.type() != train_m.type() || queryDesc.cols != train_m.cols)
+    {
+        FT_LOG_ERROR("flann query descriptors don't have the type and size of the train descriptors");
+        return;
+    }
+
+    FT_SCOPED_TIMER("flann search");
+    // flann reads the queries as one block of rows
+    const cv::Mat query = queryDesc.isContinuous() ? queryDesc : queryDesc.clone();
+    const int knn = min(k, train_m.rows);
+    const cv::flann::SearchParams search(checks_m);
+    const int numChunks = (numQueries + kQueriesPerChunk - 1) / kQueriesPerChunk;
+    cv::parallel_for_(cv::Range(0, numChunks), [&](const cv::Range& range) {
+        cv::Mat indices, distances, distancesF;
+        for (int chunk = range.start; chunk < range.end; chunk++)
+        {
+            const int begin = chunk * kQueriesPerChunk;
+            const int end = min(numQueries, begin + kQueriesPerChunk);
+            index_m->knnSearch(query.rowRange(begin, end), indices, distances, knn, search);
+            distances.convertTo(distancesF, CV_32F); // hamming distances are integers
+
+            for (int q = begin; q < end; q++)
+            {
+                const int* idx = indices.ptr<int>(q - begin);
+                const float* dist = distancesF.ptr<float>(q - begin);
+                int* outIdx = result.indices.ptr<int>(q);
+                float* outDist = result.distances.ptr<float>(q);
+                for (int j = 0; j < knn; j++)
+                {
+                    if (idx[j] < 0 || idx[j] >= train_m.rows) // LSH may find fewer than k neighbours
+                        break;
+                    outIdx[j] = idx[j];
+                    outDist[j] = bBinary_m ? dist[j] : sqrt(dist[j]); // flann gives squared L2
+                }
+            }
+        }
+    });
+}
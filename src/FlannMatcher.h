@@ -0,0 +1,49 @@
+#ifndef FLANNMATCHER_H
+#define FLANNMATCHER_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/flann.hpp>
+
+#include <string>
+
+#include "dataStructures.h" // Params
+
+// nearest neighbours of every query: row q holds the k best train indices of query q (-1 where
+// there is none, CV_32S) and their distances (CV_32F), best first
+struct KnnResult
+{
+    cv::Mat indices;
+    cv::Mat distances;
+};
+
+// Approximate nearest neighbour search over one train set with a flann index. Descriptors are
+// indexed in their own type: binary descriptors with LSH or hierarchical clustering under the
+// hamming distance, float descriptors with randomized kd-trees under L2. Nothing is converted,
+// the index keeps its own copy of the train descriptors, so it may outlive the frame they
+// belong to. The index is built once per train set, queries are answered in parallel.
+class FlannMatcher
+{
+public:
+    FlannMatcher(const Params& params);
+
+    void Build(const cv::Mat& trainDesc);
+    bool Empty() const { return train_m.empty(); }
+
+    // k is 1 or 2. Distances are hamming distances or L2 distances (not squared), the same as
+    // cv::BFMatcher gives, so matchRatio means the same for both matchers
+    void KnnSearch(const cv::Mat& queryDesc, int k, KnnResult& result) const;
+
+private:
+    cv::Ptr<cv::flann::Index> index_m;
+    cv::Mat train_m;
+    bool bBinary_m = false;
+
+    std::string binaryIndex_m;
+    int trees_m;
+    int checks_m;
+    int lshTables_m;
+    int lshKeySize_m;
+    int lshProbes_m;
+};
+
+#endif /* FLANNMATCHER_H */
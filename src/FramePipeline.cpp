@@ -0,0 +1,105 @@
+#include "FramePipeline.h"
+
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include "matching2D.hpp" // KPDetector
+#include "StaticPipeline.h"
+#include "util.h" // DetectAndDescribeFeatures
+
+using namespace std;
+
+
+FramePipeline::FramePipeline(const Params& params)
+{
+    params_m = params;
+}
+
+PipelineStats FramePipeline::Run(FrameSource& source, FeatureTracker& tracker)
+{
+    const int numWorkers = max(1, params_m.numDetectWorkers);
+    BoundedQueue<SourceFrame> decodeQueue(params_m.queueCapacity);
+    BoundedQueue<IndexedFrame> describedQueue(params_m.queueCapacity);
+
+    double t = (double)cv::getTickCount();
+
+    // stage 1 : take the grayscale frames from the source
+    thread decodeThread([&]() {
+        SourceFrame item;
+        while (source.Next(item) && decodeQueue.Push(std::move(item)))
+            item = SourceFrame();
+        decodeQueue.Close();
+    });
+
+    // stage 2 : detect and describe features, every worker owns its detector and descriptor
+    atomic<int> runningWorkers(numWorkers);
+    vector<thread> detectThreads;
+    for (int w = 0; w < numWorkers; w++)
+    {
+        detectThreads.emplace_back([&]() {
+            auto detector = CreateDetector(params_m);
+            auto descriptor = CreateDescriptor(params_m.descriptorType);
+            auto staticPipeline = params_m.bStaticPipeline ? CreateStaticPipeline(params_m) : nullptr;
+
+            SourceFrame item;
+            while (detector != nullptr && decodeQueue.Pop(item))
+            {
+                IndexedFrame described;
+                described.index = item.index;
+                described.frame = staticPipeline ? staticPipeline->DetectAndDescribe(item.imgGray)
+                                                 : DetectAndDescribeFeatures(item.imgGray, detector, descriptor, params_m);
+                if (!describedQueue.Push(std::move(described)))
+                    break;
+            }
+            // the last worker to finish tells the matching stage that no more frames will come
+            if (--runningWorkers == 0)
+                describedQueue.Close();
+        });
+    }
+
+    // stage 3 : track features on this thread, frames are put back in order first
+    map<size_t, DataFrame> reorderBuffer;
+    size_t nextIndex = 0;
+    IndexedFrame described;
+    while (describedQueue.Pop(described))
+    {
+        reorderBuffer.emplace(described.index, std::move(described.frame));
+        for (auto it = reorderBuffer.find(nextIndex); it != reorderBuffer.end(); it = reorderBuffer.find(nextIndex))
+        {
+            tracker.TrackFeatures(std::move(it->second));
+            reorderBuffer.erase(it);
+            nextIndex++;
+        }
+    }
+
+    // unblock the upstream stages in case matching stopped early
+    decodeQueue.Close();
+    decodeThread.join();
+    for (auto& th : detectThreads)
+        th.join();
+
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+    PipelineStats stats;
+    stats.numFrames = nextIndex;
+    stats.totalTime = t;
+    stats.fps = t > 0.0 ? nextIndex / t : 0.0;
+    stats.decodeQueue = decodeQueue.GetStats();
+    stats.describedQueue = describedQueue.GetStats();
+    return stats;
+}
+
+void PrintPipelineStats(const PipelineStats& stats)
+{
+    cout << "######### PIPELINE STATS ########" << "\n";
+    cout << "Processed " << stats.numFrames << " frames in " << 1000 * stats.totalTime << " ms ("
+         << stats.fps << " fps)" << "\n";
+    cout << "Decode queue    : mean " << stats.decodeQueue.meanSize << ", max " << stats.decodeQueue.maxSize
+         << " of " << stats.decodeQueue.capacity << "\n";
+    cout << "Described queue : mean " << stats.describedQueue.meanSize << ", max " << stats.describedQueue.maxSize
+         << " of " << stats.describedQueue.capacity << "\n";
+    cout << "#################################" << "\n\n";
+}
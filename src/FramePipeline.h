@@ -0,0 +1,46 @@
+#ifndef FRAMEPIPELINE_H
+#define FRAMEPIPELINE_H
+
+#include <opencv2/core.hpp>
+
+#include <string>
+#include <vector>
+
+#include "BoundedQueue.h"
+#include "dataStructures.h" // DataFrame, Params
+#include "FeatureTracker.h"
+#include "FrameSource.h"
+
+struct PipelineStats
+{
+    size_t numFrames = 0;
+    double totalTime = 0.0; // wall clock time in seconds
+    double fps = 0.0;
+    QueueStats decodeQueue; // frames of the source waiting for detection
+    QueueStats describedQueue; // described frames waiting for matching
+};
+
+// Runs image loading, detection/description and matching as concurrent stages.
+// Reading the frame source runs on its own thread, detection/description on numDetectWorkers
+// threads (each with its own detector and descriptor) and matching on the
+// calling thread, which puts the frames back in order before tracking them.
+class FramePipeline
+{
+public:
+    FramePipeline(const Params& params);
+
+    PipelineStats Run(FrameSource& source, FeatureTracker& tracker);
+
+private:
+    struct IndexedFrame
+    {
+        size_t index;
+        DataFrame frame;
+    };
+
+    Params params_m;
+};
+
+void PrintPipelineStats(const PipelineStats& stats);
+
+#endif /* FRAMEPIPELINE_H */
@@ -0,0 +1,306 @@
+#include "FrameSource.h"
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Instrumentation.h"
+
+using namespace std;
+
+namespace
+{
+
+const char kRawMagic[8] = {'F', 'T', 'R', 'A', 'W', '0', '1', '\0'};
+const size_t kRawHeaderBytes = 64;
+
+struct RawHeader
+{
+    char magic[8];
+    uint32_t width;
+    uint32_t height;
+    uint32_t numFrames;
+};
+
+bool FileExists(const string& filename)
+{
+    struct stat st;
+    return stat(filename.c_str(), &st) == 0;
+}
+
+} // namespace
+
+
+ImageFileSource::ImageFileSource(const vector<string>& files, int numDecodeThreads, size_t readAhead)
+    : files_m(files), decoded_m(readAhead), nextDecode_m(0)
+{
+    const int numThreads = max(1, numDecodeThreads);
+    runningThreads_m = numThreads;
+    for (int i = 0; i < numThreads; i++)
+    {
+        threads_m.emplace_back([this]() {
+            for (size_t index = nextDecode_m++; index < files_m.size(); index = nextDecode_m++)
+            {
+                SourceFrame frame;
+                frame.index = index;
+                {
+                    FT_SCOPED_TIMER("decode");
+                    frame.imgGray = cv::imread(files_m[index], cv::IMREAD_GRAYSCALE);
+                }
+                if (frame.imgGray.empty())
+                    FT_LOG_WARN("unable to read " << files_m[index]);
+                if (!decoded_m.Push(std::move(frame)))
+                    break;
+            }
+            // the last thread to finish ends the sequence
+            if (--runningThreads_m == 0)
+                decoded_m.Close();
+        });
+    }
+}
+
+ImageFileSource::~ImageFileSource()
+{
+    decoded_m.Close(); // unblocks decode threads waiting for space
+    for (auto& th : threads_m)
+        th.join();
+}
+
+bool ImageFileSource::Next(SourceFrame& frame)
+{
+    // frames may be finished out of order, keep the early ones until it is their turn. The
+    // decode threads take files in order, so only a few frames ever wait here
+    auto it = reorder_m.find(nextIndex_m);
+    SourceFrame decoded;
+    while (it == reorder_m.end() && decoded_m.Pop(decoded))
+    {
+        it = reorder_m.emplace(decoded.index, std::move(decoded.imgGray)).first;
+        if (it->first != nextIndex_m)
+            it = reorder_m.find(nextIndex_m);
+    }
+    if (it == reorder_m.end())
+        return false;
+
+    frame.index = nextIndex_m++;
+    frame.imgGray = std::move(it->second);
+    reorder_m.erase(it);
+    // a file which can't be read ends the sequence, like a missing file would
+    return !frame.imgGray.empty();
+}
+
+
+VideoSource::VideoSource(const string& filename, size_t firstFrame, size_t maxFrames) : capture_m(filename), maxFrames_m(maxFrames)
+{
+    // seeking is not reliable for every codec, grab skips frames without decoding them
+    for (size_t i = 0; i < firstFrame && capture_m.grab(); i++)
+        ;
+}
+
+bool VideoSource::Next(SourceFrame& frame)
+{
+    if (maxFrames_m > 0 && nextIndex_m >= maxFrames_m)
+        return false;
+    {
+        FT_SCOPED_TIMER("decode");
+        if (!capture_m.read(frame_m) || frame_m.empty())
+            return false;
+    }
+    frame.index = nextIndex_m++;
+    if (frame_m.channels() == 1)
+        frame.imgGray = frame_m.clone(); // the capture reuses its buffer
+    else
+        cv::cvtColor(frame_m, frame.imgGray, cv::COLOR_BGR2GRAY);
+    return true;
+}
+
+size_t VideoSource::NumFrames() const
+{
+    double count = capture_m.get(cv::CAP_PROP_FRAME_COUNT);
+    size_t numFrames = count > 0 ? (size_t)count : 0;
+    return maxFrames_m > 0 ? min(maxFrames_m, numFrames) : numFrames;
+}
+
+
+RawSequenceSource::RawSequenceSource(const string& filename, size_t firstFrame, size_t maxFrames)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    RawHeader header;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= kRawHeaderBytes &&
+        pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+        memcmp(header.magic, kRawMagic, sizeof(kRawMagic)) == 0)
+    {
+        // private mapping: pages are only copied if a frame is written to, never written back
+        void* mapped = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED)
+        {
+            data_m = static_cast<uint8_t*>(mapped);
+            mappedBytes_m = st.st_size;
+        }
+    }
+    close(fd); // the mapping stays valid
+
+    if (!data_m)
+    {
+        FT_LOG_ERROR(filename << " is not a raw frame sequence");
+        return;
+    }
+
+    width_m = header.width;
+    height_m = header.height;
+    dataOffset_m = kRawHeaderBytes;
+    frameBytes_m = (size_t)width_m * height_m;
+    // a truncated file only yields its complete frames
+    size_t numFrames = frameBytes_m > 0 ? min<size_t>(header.numFrames, (mappedBytes_m - dataOffset_m) / frameBytes_m) : 0;
+    firstFrame_m = min(firstFrame, numFrames);
+    endFrame_m = maxFrames > 0 ? min(numFrames, firstFrame_m + maxFrames) : numFrames;
+    nextFrame_m = firstFrame_m;
+
+    // frames are read front to back, let the kernel read ahead aggressively
+    madvise(data_m, mappedBytes_m, MADV_SEQUENTIAL);
+}
+
+RawSequenceSource::~RawSequenceSource()
+{
+    if (data_m)
+        munmap(data_m, mappedBytes_m);
+}
+
+bool RawSequenceSource::Next(SourceFrame& frame)
+{
+    if (!data_m || nextFrame_m >= endFrame_m)
+        return false;
+
+    // ask for the pages of the next frames while this one is processed
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    const size_t prefetchBegin = (dataOffset_m + (nextFrame_m + 1) * frameBytes_m) / pageSize * pageSize;
+    const size_t prefetchEnd = min(mappedBytes_m, dataOffset_m + (nextFrame_m + 3) * frameBytes_m);
+    if (prefetchBegin < prefetchEnd)
+        madvise(data_m + prefetchBegin, prefetchEnd - prefetchBegin, MADV_WILLNEED);
+
+    frame.index = nextFrame_m - firstFrame_m;
+    frame.imgGray = cv::Mat(height_m, width_m, CV_8UC1, const_cast<uint8_t*>(FramePtr(nextFrame_m)));
+    nextFrame_m++;
+    return true;
+}
+
+
+PrefetchSource::PrefetchSource(unique_ptr<FrameSource> source, size_t capacity)
+    : source_m(std::move(source)), queue_m(capacity)
+{
+    thread_m = thread([this]() {
+        SourceFrame frame;
+        while (source_m->Next(frame) && queue_m.Push(std::move(frame)))
+            frame = SourceFrame();
+        queue_m.Close();
+    });
+}
+
+PrefetchSource::~PrefetchSource()
+{
+    queue_m.Close();
+    thread_m.join();
+}
+
+bool PrefetchSource::Next(SourceFrame& frame)
+{
+    return queue_m.Pop(frame);
+}
+
+
+size_t WriteRawSequence(FrameSource& source, const string& filename)
+{
+    ofstream out(filename, ios::binary);
+    if (!out)
+    {
+        FT_LOG_ERROR("unable to open " << filename);
+        return 0;
+    }
+
+    RawHeader header;
+    memcpy(header.magic, kRawMagic, sizeof(kRawMagic));
+    header.width = header.height = header.numFrames = 0;
+    vector<char> headerBytes(kRawHeaderBytes, 0);
+    out.write(headerBytes.data(), headerBytes.size()); // written again once the frame count is known
+
+    SourceFrame frame;
+    while (source.Next(frame))
+    {
+        if (header.numFrames == 0)
+        {
+            header.width = frame.imgGray.cols;
+            header.height = frame.imgGray.rows;
+        }
+        else if ((int)header.width != frame.imgGray.cols || (int)header.height != frame.imgGray.rows)
+        {
+            FT_LOG_WARN("frame " << frame.index << " has a different size, stopping the export");
+            break;
+        }
+        for (int row = 0; row < frame.imgGray.rows; row++)
+            out.write(frame.imgGray.ptr<char>(row), frame.imgGray.cols);
+        header.numFrames++;
+    }
+
+    memcpy(headerBytes.data(), &header, sizeof(header));
+    out.seekp(0);
+    out.write(headerBytes.data(), headerBytes.size());
+    FT_LOG_INFO("Wrote " << header.numFrames << " frames of " << header.width << "x" << header.height << " to " << filename);
+    return header.numFrames;
+}
+
+unique_ptr<FrameSource> CreateFrameSource(const Params& params)
+{
+    const size_t maxFrames = params.numFrames > 0 ? params.numFrames : 0;
+    unique_ptr<FrameSource> source;
+    if (params.sourceType.compare("IMAGES") == 0)
+    {
+        // numFrames = 0 takes every file up to the first missing one
+        vector<string> files;
+        for (size_t i = 0; maxFrames == 0 || i < maxFrames; i++)
+        {
+            string filename = cv::format(params.sourcePath.c_str(), params.firstFrame + (int)i);
+            if (!FileExists(filename))
+                break;
+            files.push_back(filename);
+        }
+        if (files.empty())
+        {
+            FT_LOG_ERROR("no images found for " << params.sourcePath);
+            return nullptr;
+        }
+        source.reset(new ImageFileSource(files, params.decodeThreads, params.prefetchFrames));
+    }
+    else if (params.sourceType.compare("VIDEO") == 0)
+    {
+        unique_ptr<VideoSource> video(new VideoSource(params.sourcePath, max(0, params.firstFrame), maxFrames));
+        if (!video->IsOpened())
+        {
+            FT_LOG_ERROR("unable to open video " << params.sourcePath);
+            return nullptr;
+        }
+        source.reset(new PrefetchSource(std::move(video), params.prefetchFrames));
+    }
+    else if (params.sourceType.compare("RAW") == 0)
+    {
+        unique_ptr<RawSequenceSource> raw(new RawSequenceSource(params.sourcePath, max(0, params.firstFrame), maxFrames));
+        if (!raw->IsOpened())
+            return nullptr;
+        source = std::move(raw);
+    }
+    else
+    {
+        FT_LOG_ERROR(params.sourceType << " is not a valid source type!");
+    }
+    return source;
+}
@@ -0,0 +1,130 @@
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.h"
+#include "dataStructures.h" // Params
+
+struct SourceFrame
+{
+    size_t index = 0; // position in the sequence, starting at 0
+    cv::Mat imgGray;  // 8 bit grayscale
+};
+
+// Sequence of grayscale frames. Next() hands out the frames in order and is called from
+// one thread only.
+class FrameSource
+{
+public:
+    virtual ~FrameSource() {}
+
+    // false at the end of the sequence
+    virtual bool Next(SourceFrame& frame) = 0;
+
+    // no. of frames if it is known up front, otherwise 0
+    virtual size_t NumFrames() const { return 0; }
+};
+
+// Image files (png, jpg, ...) decoded by several threads which read ahead of the consumer.
+// The frames are decoded directly to grayscale, there is no color conversion.
+class ImageFileSource : public FrameSource
+{
+public:
+    ImageFileSource(const std::vector<std::string>& files, int numDecodeThreads, size_t readAhead);
+    ~ImageFileSource();
+
+    bool Next(SourceFrame& frame) override;
+    size_t NumFrames() const override { return files_m.size(); }
+
+private:
+    std::vector<std::string> files_m;
+    BoundedQueue<SourceFrame> decoded_m;      // decoded frames, not in order
+    std::map<size_t, cv::Mat> reorder_m;      // frames which came before their turn
+    size_t nextIndex_m = 0;
+    std::atomic<size_t> nextDecode_m;         // next file to be taken by a decode thread
+    std::atomic<int> runningThreads_m;
+    std::vector<std::thread> threads_m;
+};
+
+// Video file read through cv::VideoCapture, frames are decoded sequentially.
+class VideoSource : public FrameSource
+{
+public:
+    explicit VideoSource(const std::string& filename, size_t firstFrame = 0, size_t maxFrames = 0);
+
+    bool Next(SourceFrame& frame) override;
+    size_t NumFrames() const override; // frames left from the first frame on
+    bool IsOpened() const { return capture_m.isOpened(); }
+
+private:
+    cv::VideoCapture capture_m;
+    cv::Mat frame_m;
+    size_t maxFrames_m;
+    size_t nextIndex_m = 0;
+};
+
+// Packed raw grayscale sequence, see WriteRawSequence for the layout. The file is memory
+// mapped and the frames are handed out as headers into the mapping, without copy or decode.
+// They stay valid as long as the source is alive.
+class RawSequenceSource : public FrameSource
+{
+public:
+    explicit RawSequenceSource(const std::string& filename, size_t firstFrame = 0, size_t maxFrames = 0);
+    ~RawSequenceSource();
+
+    RawSequenceSource(const RawSequenceSource&) = delete;
+    RawSequenceSource& operator=(const RawSequenceSource&) = delete;
+
+    bool Next(SourceFrame& frame) override;
+    size_t NumFrames() const override { return endFrame_m - firstFrame_m; }
+    bool IsOpened() const { return data_m != nullptr; }
+
+private:
+    const uint8_t* FramePtr(size_t frame) const { return data_m + dataOffset_m + frame * frameBytes_m; }
+
+    uint8_t* data_m = nullptr;
+    size_t mappedBytes_m = 0;
+    size_t dataOffset_m = 0;
+    size_t frameBytes_m = 0;
+    int width_m = 0;
+    int height_m = 0;
+    size_t firstFrame_m = 0;
+    size_t endFrame_m = 0;
+    size_t nextFrame_m = 0;
+};
+
+// Runs another source on its own thread and keeps up to capacity frames ready.
+class PrefetchSource : public FrameSource
+{
+public:
+    PrefetchSource(std::unique_ptr<FrameSource> source, size_t capacity);
+    ~PrefetchSource();
+
+    bool Next(SourceFrame& frame) override;
+    size_t NumFrames() const override { return source_m->NumFrames(); }
+
+private:
+    std::unique_ptr<FrameSource> source_m;
+    BoundedQueue<SourceFrame> queue_m;
+    std::thread thread_m;
+};
+
+// Raw sequence layout: 64 byte header (magic "FTRAW01\0", then uint32 width, height,
+// no. of frames), followed by the frames as packed 8 bit rows. Returns the no. of frames written.
+size_t WriteRawSequence(FrameSource& source, const std::string& filename);
+
+// sourceType IMAGES, VIDEO or RAW. IMAGES expands sourcePath as printf pattern with the frame
+// number, starting at firstFrame. Returns nullptr if the source can't be opened.
+std::unique_ptr<FrameSource> CreateFrameSource(const Params& params);
+
+#endif /* FRAMESOURCE_H */
@@ -0,0 +1,322 @@
+#include "GeometricVerification.h"
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp> // getPerspectiveTransform
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+
+// scoring checks after every block of this many matches whether the model can still reach the
+// no. of inliers it needs, a multiple of 8
+const int kBailOutBlock = 64;
+
+// min. area of the parallelogram spanned by three points of a homography sample in pixels^2
+const float kMinSampleArea = 1.0f;
+
+// Inliers of a homography among the matches [begin, end): the reprojection error |H x1 / w - x2|
+// is below the threshold, compared as |H x1 - w x2|^2 < t^2 w^2 without division
+int HomographyInliers(const float* h, const float* x1, const float* y1, const float* x2, const float* y2,
+                      int begin, int end, float thr2, uchar* mask)
+{
+    int count = 0;
+    int i = begin;
+#if defined(__AVX2__)
+    const __m256 h0 = _mm256_set1_ps(h[0]), h1 = _mm256_set1_ps(h[1]), h2 = _mm256_set1_ps(h[2]);
+    const __m256 h3 = _mm256_set1_ps(h[3]), h4 = _mm256_set1_ps(h[4]), h5 = _mm256_set1_ps(h[5]);
+    const __m256 h6 = _mm256_set1_ps(h[6]), h7 = _mm256_set1_ps(h[7]), h8 = _mm256_set1_ps(h[8]);
+    const __m256 t2 = _mm256_set1_ps(thr2);
+    for (; i + 8 <= end; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(x1 + i), y = _mm256_loadu_ps(y1 + i);
+        const __m256 u = _mm256_loadu_ps(x2 + i), v = _mm256_loadu_ps(y2 + i);
+        const __m256 w = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(h6, x), _mm256_mul_ps(h7, y)), h8);
+        const __m256 du = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(h0, x), _mm256_mul_ps(h1, y)), h2), _mm256_mul_ps(u, w));
+        const __m256 dv = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(h3, x), _mm256_mul_ps(h4, y)), h5), _mm256_mul_ps(v, w));
+        const __m256 err = _mm256_add_ps(_mm256_mul_ps(du, du), _mm256_mul_ps(dv, dv));
+        const int bits = _mm256_movemask_ps(_mm256_cmp_ps(err, _mm256_mul_ps(t2, _mm256_mul_ps(w, w)), _CMP_LT_OQ));
+        count += __builtin_popcount(bits);
+        if (mask)
+            for (int k = 0; k < 8; k++)
+                mask[i + k] = (bits >> k) & 1;
+    }
+#endif
+    for (; i < end; i++)
+    {
+        const float w = h[6] * x1[i] + h[7] * y1[i] + h[8];
+        const float du = h[0] * x1[i] + h[1] * y1[i] + h[2] - x2[i] * w;
+        const float dv = h[3] * x1[i] + h[4] * y1[i] + h[5] - y2[i] * w;
+        const bool bInlier = du * du + dv * dv < thr2 * (w * w);
+        count += bInlier;
+        if (mask)
+            mask[i] = bInlier;
+    }
+    return count;
+}
+
+// Inliers of a fundamental matrix among the matches [begin, end): the Sampson distance
+// e^2 / (a2^2 + b2^2 + a1^2 + b1^2) is below the threshold, with e = x2^T F x1,
+// (a2, b2) from the epipolar line F x1 and (a1, b1) from F^T x2
+int FundamentalInliers(const float* f, const float* x1, const float* y1, const float* x2, const float* y2,
+                       int begin, int end, float thr2, uchar* mask)
+{
+    int count = 0;
+    int i = begin;
+#if defined(__AVX2__)
+    const __m256 f0 = _mm256_set1_ps(f[0]), f1 = _mm256_set1_ps(f[1]), f2 = _mm256_set1_ps(f[2]);
+    const __m256 f3 = _mm256_set1_ps(f[3]), f4 = _mm256_set1_ps(f[4]), f5 = _mm256_set1_ps(f[5]);
+    const __m256 f6 = _mm256_set1_ps(f[6]), f7 = _mm256_set1_ps(f[7]), f8 = _mm256_set1_ps(f[8]);
+    const __m256 t2 = _mm256_set1_ps(thr2);
+    for (; i + 8 <= end; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(x1 + i), y = _mm256_loadu_ps(y1 + i);
+        const __m256 u = _mm256_loadu_ps(x2 + i), v = _mm256_loadu_ps(y2 + i);
+        const __m256 a2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(f0, x), _mm256_mul_ps(f1, y)), f2);
+        const __m256 b2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(f3, x), _mm256_mul_ps(f4, y)), f5);
+        const __m256 c2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(f6, x), _mm256_mul_ps(f7, y)), f8);
+        const __m256 a1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(f0, u), _mm256_mul_ps(f3, v)), f6);
+        const __m256 b1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(f1, u), _mm256_mul_ps(f4, v)), f7);
+        const __m256 e = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a2, u), _mm256_mul_ps(b2, v)), c2);
+        const __m256 denom = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a2, a2), _mm256_mul_ps(b2, b2)),
+                                           _mm256_add_ps(_mm256_mul_ps(a1, a1), _mm256_mul_ps(b1, b1)));
+        const int bits = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_mul_ps(e, e), _mm256_mul_ps(t2, denom), _CMP_LT_OQ));
+        count += __builtin_popcount(bits);
+        if (mask)
+            for (int k = 0; k < 8; k++)
+                mask[i + k] = (bits >> k) & 1;
+    }
+#endif
+    for (; i < end; i++)
+    {
+        const float a2 = f[0] * x1[i] + f[1] * y1[i] + f[2];
+        const float b2 = f[3] * x1[i] + f[4] * y1[i] + f[5];
+        const float c2 = f[6] * x1[i] + f[7] * y1[i] + f[8];
+        const float a1 = f[0] * x2[i] + f[3] * y2[i] + f[6];
+        const float b1 = f[1] * x2[i] + f[4] * y2[i] + f[7];
+        const float e = a2 * x2[i] + b2 * y2[i] + c2;
+        const bool bInlier = e * e < thr2 * (a2 * a2 + b2 * b2 + a1 * a1 + b1 * b1);
+        count += bInlier;
+        if (mask)
+            mask[i] = bInlier;
+    }
+    return count;
+}
+
+// true if three of the four points are (nearly) on one line
+bool Collinear(const vector<cv::Point2f>& p)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        const cv::Point2f& a = p[i];
+        const cv::Point2f& b = p[(i + 1) % 4];
+        const cv::Point2f& c = p[(i + 2) % 4];
+        if (fabs((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x)) < kMinSampleArea)
+            return true;
+    }
+    return false;
+}
+
+} // namespace
+
+
+GeometricVerifier::GeometricVerifier(const Params& params)
+    : bHomography_m(params.geomModel == "HOMOGRAPHY"),
+      threshold_m(params.geomThreshold),
+      confidence_m(params.geomConfidence),
+      maxIters_m(max(1, params.geomMaxIters)),
+      minMatches_m(params.geomMinMatches),
+      rng_m(1)
+{
+}
+
+bool GeometricVerifier::Verify(const FeatureStore& source, const FeatureStore& ref, const vector<cv::DMatch>& matches,
+                               const vector<float>& ratios, GeometryResult& result)
+{
+    result = GeometryResult();
+    const int n = (int)matches.size();
+    const int m = SampleSize();
+    if (n < max(minMatches_m, m + 1))
+        return false;
+
+    // quality order: the most distinctive matches first, then the closest
+    vector<int> order(n);
+    iota(order.begin(), order.end(), 0);
+    const bool bRatios = ratios.size() == matches.size();
+    stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        if (bRatios && ratios[a] != ratios[b])
+            return ratios[a] < ratios[b];
+        return matches[a].distance < matches[b].distance;
+    });
+    x1_m.resize(n);
+    y1_m.resize(n);
+    x2_m.resize(n);
+    y2_m.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        const cv::DMatch& match = matches[order[i]];
+        x1_m[i] = source.x()[match.queryIdx];
+        y1_m[i] = source.y()[match.queryIdx];
+        x2_m[i] = ref.x()[match.trainIdx];
+        y2_m[i] = ref.y()[match.trainIdx];
+    }
+
+    // PROSAC: the samples are drawn from the best `subset` matches, which grows so that
+    // after maxIters_m samples it would cover all matches. Tn is the expected no. of samples
+    // from the first subset matches among maxIters_m uniform samples, TnPrime its integer count
+    double Tn = maxIters_m;
+    for (int i = 0; i < m; i++)
+        Tn *= (double)(m - i) / (n - i);
+    double TnPrime = 1.0;
+    int subset = m;
+
+    cv::Mat best;
+    int bestCount = 0;
+    int maxIterations = maxIters_m;
+    int t = 0;
+    vector<int> sample(m);
+    vector<cv::Mat> models;
+    while (t < maxIterations)
+    {
+        t++;
+        if (t > TnPrime && subset < n)
+        {
+            const double TnNext = Tn * (subset + 1) / (subset + 1 - m);
+            TnPrime += ceil(TnNext - Tn);
+            Tn = TnNext;
+            subset++;
+        }
+        // until the subset has been used TnPrime times its newest match is in every sample
+        DrawSample(subset, TnPrime >= t, sample.data());
+        FitSample(sample.data(), models);
+
+        for (const auto& model : models)
+        {
+            const int count = CountInliers(model, bestCount + 1, nullptr);
+            if (count <= bestCount)
+                continue;
+            best = model;
+            bestCount = count;
+
+            // adaptive termination: no. of samples after which an all inlier sample was drawn
+            // with geomConfidence, for the inlier ratio of the best model
+            const double pBad = 1.0 - pow((double)count / n, m);
+            if (pBad <= 0.0)
+                maxIterations = t;
+            else if (pBad < 1.0)
+                maxIterations = (int)min((double)maxIterations, ceil(log(1.0 - confidence_m) / log(pBad)));
+        }
+    }
+    result.iterations = t;
+    if (best.empty())
+        return false;
+
+    vector<uchar> mask(n);
+    int count = CountInliers(best, 0, mask.data());
+
+    // least squares fit to all inliers, kept if it explains at least as many matches
+    cv::Mat refined = Refit(mask);
+    if (refined.rows == 3 && refined.cols == 3)
+    {
+        vector<uchar> refinedMask(n);
+        const int refinedCount = CountInliers(refined, 0, refinedMask.data());
+        if (refinedCount >= count)
+        {
+            best = refined;
+            mask.swap(refinedMask);
+            count = refinedCount;
+        }
+    }
+
+    result.model = best.clone();
+    result.inlierMask.assign(n, 0);
+    for (int i = 0; i < n; i++)
+        result.inlierMask[order[i]] = mask[i];
+    result.numInliers = count;
+    return true;
+}
+
+// distinct indices below n, with bIncludeLast the first one is n - 1 and the others are below it
+void GeometricVerifier::DrawSample(int n, bool bIncludeLast, int* sample)
+{
+    const int m = SampleSize();
+    int k = 0;
+    if (bIncludeLast)
+        sample[k++] = n - 1;
+    uniform_int_distribution<int> pick(0, (bIncludeLast ? n - 1 : n) - 1);
+    while (k < m)
+    {
+        const int idx = pick(rng_m);
+        if (find(sample, sample + k, idx) == sample + k)
+            sample[k++] = idx;
+    }
+}
+
+// minimal solutions of a sample: one homography, or up to three fundamental matrices
+void GeometricVerifier::FitSample(const int* sample, vector<cv::Mat>& models) const
+{
+    models.clear();
+    const int m = SampleSize();
+    vector<cv::Point2f> p1(m), p2(m);
+    for (int k = 0; k < m; k++)
+    {
+        p1[k] = cv::Point2f(x1_m[sample[k]], y1_m[sample[k]]);
+        p2[k] = cv::Point2f(x2_m[sample[k]], y2_m[sample[k]]);
+    }
+
+    if (bHomography_m)
+    {
+        if (!Collinear(p1) && !Collinear(p2))
+            models.push_back(cv::getPerspectiveTransform(p1, p2));
+        return;
+    }
+    const cv::Mat solutions = cv::findFundamentalMat(p1, p2, cv::FM_7POINT);
+    for (int r = 0; r + 3 <= solutions.rows; r += 3)
+        models.push_back(solutions.rowRange(r, r + 3));
+}
+
+// no. of inliers of the model, or -1 as soon as it can't reach needed. With a mask every
+// match is scored and marked
+int GeometricVerifier::CountInliers(const cv::Mat& model, int needed, uchar* mask) const
+{
+    float coeffs[9];
+    for (int i = 0; i < 9; i++)
+        coeffs[i] = (float)model.at<double>(i / 3, i % 3);
+    const float thr2 = threshold_m * threshold_m;
+    const int n = (int)x1_m.size();
+
+    int count = 0;
+    for (int begin = 0; begin < n; begin += kBailOutBlock)
+    {
+        const int end = min(n, begin + kBailOutBlock);
+        count += bHomography_m ? HomographyInliers(coeffs, x1_m.data(), y1_m.data(), x2_m.data(), y2_m.data(), begin, end, thr2, mask)
+                               : FundamentalInliers(coeffs, x1_m.data(), y1_m.data(), x2_m.data(), y2_m.data(), begin, end, thr2, mask);
+        if (!mask && count + (n - end) < needed)
+            return -1;
+    }
+    return count;
+}
+
+// least squares model of the matches in the mask
+cv::Mat GeometricVerifier::Refit(const vector<uchar>& mask) const
+{
+    vector<cv::Point2f> p1, p2;
+    for (size_t i = 0; i < mask.size(); i++)
+    {
+        if (!mask[i])
+            continue;
+        p1.emplace_back(x1_m[i], y1_m[i]);
+        p2.emplace_back(x2_m[i], y2_m[i]);
+    }
+    if (bHomography_m)
+        return p1.size() >= 4 ? cv::findHomography(p1, p2, 0) : cv::Mat();
+    return p1.size() >= 8 ? cv::findFundamentalMat(p1, p2, cv::FM_8POINT) : cv::Mat();
+}
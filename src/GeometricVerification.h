@@ -0,0 +1,59 @@
+#ifndef GEOMETRICVERIFICATION_H
+#define GEOMETRICVERIFICATION_H
+
+#include <opencv2/core.hpp>
+
+#include <random>
+#include <vector>
+
+#include "dataStructures.h" // Params
+#include "FeatureStore.h"
+
+// epipolar geometry or homography between two frames, fitted to their matches
+struct GeometryResult
+{
+    // 3x3 CV_64F, empty if no model was found. FUNDAMENTAL: x_ref^T F x_source = 0,
+    // HOMOGRAPHY: x_ref ~ H x_source, with the source keypoints (queryIdx) and ref keypoints (trainIdx)
+    cv::Mat model;
+    std::vector<uchar> inlierMask; // one entry per match, 1 for an inlier. Empty if no model was found
+    int numInliers = 0;
+    int iterations = 0; // no. of samples drawn
+};
+
+// Robust fit of a fundamental matrix (7 point samples) or a homography (4 point samples) to the
+// matches of a frame pair. Samples are drawn PROSAC style: the matches are ordered by quality
+// (ratio test margin, then distance) and the samples start from the best matches and grow
+// towards the whole set, so good models turn up after few samples. The residuals of all matches
+// are scored 8 at a time with AVX2 if the compiler targets it, and scoring a model stops as soon
+// as it can't beat the best one. Sampling ends once a better model is unlikely
+// (geomConfidence) or after geomMaxIters samples, the best model is refitted to its inliers.
+class GeometricVerifier
+{
+public:
+    explicit GeometricVerifier(const Params& params);
+
+    // ratios: best to second best distance of every match, lower is more distinctive. Empty
+    // orders the matches by distance only. Returns false (and an empty result) for fewer than
+    // geomMinMatches matches or if no model was found
+    bool Verify(const FeatureStore& source, const FeatureStore& ref, const std::vector<cv::DMatch>& matches,
+                const std::vector<float>& ratios, GeometryResult& result);
+
+private:
+    int SampleSize() const { return bHomography_m ? 4 : 7; }
+    void DrawSample(int n, bool bIncludeLast, int* sample);
+    void FitSample(const int* sample, std::vector<cv::Mat>& models) const;
+    int CountInliers(const cv::Mat& model, int needed, uchar* mask) const;
+    cv::Mat Refit(const std::vector<uchar>& mask) const;
+
+    bool bHomography_m;
+    float threshold_m;
+    double confidence_m;
+    int maxIters_m;
+    int minMatches_m;
+    std::mt19937 rng_m; // fixed seed, results are repeatable
+
+    // matched points in quality order, structure of arrays for the scoring kernels
+    std::vector<float> x1_m, y1_m, x2_m, y2_m;
+};
+
+#endif /* GEOMETRICVERIFICATION_H */
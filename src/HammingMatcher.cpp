@@ -0,0 +1,171 @@
+#include "HammingMatcher.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__AVX512F__) || defined(__POPCNT__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+
+// no. of bytes of train descriptors processed per block, chosen to stay in the L1 cache
+const int kTrainBlockBytes = 16 * 1024;
+
+inline int Popcount64(uint64_t x)
+{
+#if defined(__POPCNT__)
+    return (int)_mm_popcnt_u64(x);
+#else
+    return __builtin_popcountll(x);
+#endif
+}
+
+inline int HammingScalar(const uint8_t* a, const uint8_t* b, int n)
+{
+    int dist = 0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t wa, wb;
+        memcpy(&wa, a + i, 8);
+        memcpy(&wb, b + i, 8);
+        dist += Popcount64(wa ^ wb);
+    }
+    for (; i < n; i++)
+        dist += Popcount64((uint64_t)(a[i] ^ b[i]));
+    return dist;
+}
+
+#if defined(__AVX2__)
+// per byte popcount with a nibble lookup table, summed into the four 64 bit lanes
+inline __m256i Popcount256(__m256i v)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowMask = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_and_si256(v, lowMask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask);
+    __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+    return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+}
+#endif
+
+inline int Hamming(const uint8_t* a, const uint8_t* b, int n)
+{
+    int i = 0;
+    int dist = 0;
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+    __m512i acc512 = _mm512_setzero_si512();
+    for (; i + 64 <= n; i += 64)
+    {
+        __m512i x = _mm512_xor_si512(_mm512_loadu_si512((const void*)(a + i)), _mm512_loadu_si512((const void*)(b + i)));
+        acc512 = _mm512_add_epi64(acc512, _mm512_popcnt_epi64(x));
+    }
+    dist += (int)_mm512_reduce_add_epi64(acc512);
+#endif
+#if defined(__AVX2__)
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+        acc = _mm256_add_epi64(acc, Popcount256(x));
+    }
+    dist += (int)(_mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1) +
+                  _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3));
+#endif
+    return dist + HammingScalar(a + i, b + i, n - i);
+}
+
+inline void UpdateBest2(Best2Match& m, int trainIdx, int dist)
+{
+    if (dist < m.distance[0])
+    {
+        m.distance[1] = m.distance[0];
+        m.trainIdx[1] = m.trainIdx[0];
+        m.distance[0] = dist;
+        m.trainIdx[0] = trainIdx;
+    }
+    else if (dist < m.distance[1])
+    {
+        m.distance[1] = dist;
+        m.trainIdx[1] = trainIdx;
+    }
+}
+
+} // namespace
+
+
+int HammingDistance(const uint8_t* a, const uint8_t* b, int n)
+{
+    return Hamming(a, b, n);
+}
+
+void HammingBest2(const uint8_t* query, size_t queryStep, int queryBegin, int queryEnd,
+                  const uint8_t* train, size_t trainStep, int numTrain,
+                  int descBytes, Best2Match* matches)
+{
+    const int blockRows = max(1, kTrainBlockBytes / max(1, descBytes));
+    for (int q = queryBegin; q < queryEnd; q++)
+        matches[q] = Best2Match();
+
+    // keep one block of train descriptors hot in the cache while all queries run over it
+    for (int blockBegin = 0; blockBegin < numTrain; blockBegin += blockRows)
+    {
+        const int blockEnd = min(numTrain, blockBegin + blockRows);
+        for (int q = queryBegin; q < queryEnd; q++)
+        {
+            const uint8_t* qDesc = query + q * queryStep;
+            Best2Match& m = matches[q];
+            for (int t = blockBegin; t < blockEnd; t++)
+                UpdateBest2(m, t, Hamming(qDesc, train + t * trainStep, descBytes));
+        }
+    }
+}
+
+void HammingMatcher::KnnMatch2(const cv::Mat& queryDesc, const cv::Mat& trainDesc, vector<Best2Match>& matches) const
+{
+    CV_Assert(queryDesc.depth() == CV_8U && trainDesc.depth() == CV_8U);
+    CV_Assert(queryDesc.empty() || trainDesc.empty() || queryDesc.cols == trainDesc.cols);
+
+    matches.resize(queryDesc.rows);
+    if (queryDesc.empty() || trainDesc.empty())
+        return;
+
+    // queries are independent, split them into stripes which run on opencv's thread pool
+    cv::parallel_for_(cv::Range(0, queryDesc.rows), [&](const cv::Range& range) {
+        HammingBest2(queryDesc.data, queryDesc.step, range.start, range.end,
+                     trainDesc.data, trainDesc.step, trainDesc.rows,
+                     queryDesc.cols * (int)queryDesc.elemSize(), matches.data());
+    });
+}
+
+void HammingMatcher::Match(const cv::Mat& queryDesc, const cv::Mat& trainDesc, vector<cv::DMatch>& matches) const
+{
+    vector<Best2Match> best2;
+    KnnMatch2(queryDesc, trainDesc, best2);
+
+    matches.clear();
+    matches.reserve(best2.size());
+    for (size_t q = 0; q < best2.size(); q++)
+    {
+        if (best2[q].trainIdx[0] >= 0)
+            matches.emplace_back(q, best2[q].trainIdx[0], (float)best2[q].distance[0]);
+    }
+}
+
+const char* HammingMatcher::InstructionSet()
+{
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+    return "AVX-512 VPOPCNTDQ";
+#elif defined(__AVX2__)
+    return "AVX2";
+#elif defined(__POPCNT__)
+    return "POPCNT";
+#else
+    return "scalar";
+#endif
+}
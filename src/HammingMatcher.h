@@ -0,0 +1,39 @@
+#ifndef HAMMINGMATCHER_H
+#define HAMMINGMATCHER_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// best and second best match of one query descriptor
+struct Best2Match
+{
+    int trainIdx[2] = {-1, -1};
+    int distance[2] = {INT32_MAX, INT32_MAX};
+};
+
+// Brute force matcher for binary descriptors (ORB, BRISK, BRIEF, FREAK, AKAZE).
+// Distances are computed with popcount using AVX-512, AVX2 or POPCNT, depending on
+// what the compiler targets, and the train descriptors are processed in blocks which
+// fit into the L1 cache. The two best matches of every query are found in one pass.
+class HammingMatcher
+{
+public:
+    // descriptors are CV_8U matrices with one descriptor per row
+    void KnnMatch2(const cv::Mat& queryDesc, const cv::Mat& trainDesc, std::vector<Best2Match>& matches) const;
+    void Match(const cv::Mat& queryDesc, const cv::Mat& trainDesc, std::vector<cv::DMatch>& matches) const;
+
+    static const char* InstructionSet();
+};
+
+// hamming distance between two descriptors of n bytes
+int HammingDistance(const uint8_t* a, const uint8_t* b, int n);
+
+// kernel working on raw descriptor rows, queries [queryBegin, queryEnd) are matched against all train rows
+void HammingBest2(const uint8_t* query, size_t queryStep, int queryBegin, int queryEnd,
+                  const uint8_t* train, size_t trainStep, int numTrain,
+                  int descBytes, Best2Match* matches);
+
+#endif /* HAMMINGMATCHER_H */
@@ -0,0 +1,192 @@
+#include "Instrumentation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+atomic<int> logLevel((int)LogLevel::Info);
+atomic<bool> tracingEnabled(false);
+mutex logMutex;
+
+const char* LevelName(LogLevel level)
+{
+    switch (level)
+    {
+    case LogLevel::Trace: return "TRACE";
+    case LogLevel::Debug: return "DEBUG";
+    case LogLevel::Info: return "INFO";
+    case LogLevel::Warn: return "WARN";
+    case LogLevel::Error: return "ERROR";
+    default: return "OFF";
+    }
+}
+
+struct TraceEvent
+{
+    const char* name;
+    int64_t timestamp; // ns
+    int64_t duration;  // ns, duration events only
+    double value;      // counters only
+    bool bCounter;
+};
+
+// Events of one thread. Only the owning thread writes, when the buffer is full the oldest
+// events are overwritten, so long runs keep the most recent part of the trace.
+struct ThreadTraceBuffer
+{
+    static const size_t kCapacity = 1 << 16;
+
+    explicit ThreadTraceBuffer(int id) : threadId(id), events(kCapacity) {}
+
+    void Push(const TraceEvent& event)
+    {
+        events[numEvents % kCapacity] = event;
+        numEvents++;
+    }
+
+    int threadId;
+    vector<TraceEvent> events;
+    size_t numEvents = 0;
+};
+
+const size_t ThreadTraceBuffer::kCapacity; // std::min takes it by reference
+
+// buffers of all threads which recorded something, they outlive their threads so the
+// trace can be written at the end of the run
+mutex registryMutex;
+vector<shared_ptr<ThreadTraceBuffer>> registry;
+
+ThreadTraceBuffer& LocalBuffer()
+{
+    thread_local shared_ptr<ThreadTraceBuffer> buffer;
+    if (!buffer)
+    {
+        lock_guard<mutex> lock(registryMutex);
+        buffer = make_shared<ThreadTraceBuffer>((int)registry.size());
+        registry.push_back(buffer);
+    }
+    return *buffer;
+}
+
+void WriteJsonString(ostream& out, const char* s)
+{
+    out << '"';
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            out << '\\';
+        out << *s;
+    }
+    out << '"';
+}
+
+} // namespace
+
+
+void SetLogLevel(LogLevel level)
+{
+    logLevel = (int)level;
+}
+
+LogLevel GetLogLevel()
+{
+    return (LogLevel)logLevel.load();
+}
+
+bool LogEnabled(LogLevel level)
+{
+    return (int)level >= logLevel.load(memory_order_relaxed);
+}
+
+LogLevel ParseLogLevel(const string& name)
+{
+    for (int level = (int)LogLevel::Trace; level <= (int)LogLevel::Off; level++)
+        if (name == LevelName((LogLevel)level))
+            return (LogLevel)level;
+    return LogLevel::Info;
+}
+
+void WriteLog(LogLevel level, const string& message)
+{
+    // one lock per message so lines of the worker threads don't interleave, no flush
+    lock_guard<mutex> lock(logMutex);
+    ostream& out = level >= LogLevel::Warn ? cerr : cout;
+    out << message << '\n';
+}
+
+void EnableTracing(bool enable)
+{
+    tracingEnabled = enable;
+}
+
+bool TracingEnabled()
+{
+    return tracingEnabled.load(memory_order_relaxed);
+}
+
+void RecordDuration(const char* name, int64_t startNs, int64_t durationNs)
+{
+    LocalBuffer().Push(TraceEvent{name, startNs, durationNs, 0.0, false});
+}
+
+void RecordCounter(const char* name, double value)
+{
+    LocalBuffer().Push(TraceEvent{name, TraceNow(), 0, value, true});
+}
+
+bool WriteChromeTrace(const string& filename)
+{
+    ofstream out(filename);
+    if (!out)
+    {
+        FT_LOG_ERROR("unable to open " << filename);
+        return false;
+    }
+
+    lock_guard<mutex> lock(registryMutex);
+    int64_t origin = INT64_MAX;
+    for (const auto& buffer : registry)
+    {
+        const size_t n = min(buffer->numEvents, ThreadTraceBuffer::kCapacity);
+        for (size_t i = 0; i < n; i++)
+            origin = min(origin, buffer->events[i].timestamp);
+    }
+
+    // timestamps in microseconds relative to the first event
+    out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+    bool bFirst = true;
+    size_t numEvents = 0;
+    for (const auto& buffer : registry)
+    {
+        const size_t n = min(buffer->numEvents, ThreadTraceBuffer::kCapacity);
+        const size_t begin = buffer->numEvents - n;
+        for (size_t i = begin; i < buffer->numEvents; i++)
+        {
+            const TraceEvent& e = buffer->events[i % ThreadTraceBuffer::kCapacity];
+            out << (bFirst ? "\n" : ",\n") << "{\"name\":";
+            WriteJsonString(out, e.name);
+            out << ",\"ph\":\"" << (e.bCounter ? 'C' : 'X') << "\",\"pid\":1,\"tid\":" << buffer->threadId
+                << ",\"ts\":" << 1e-3 * (e.timestamp - origin);
+            if (e.bCounter)
+                out << ",\"args\":{\"value\":" << e.value << "}}";
+            else
+                out << ",\"dur\":" << 1e-3 * e.duration << "}";
+            bFirst = false;
+            numEvents++;
+        }
+    }
+    out << "\n]}\n";
+
+    FT_LOG_INFO("Wrote " << numEvents << " trace events to " << filename);
+    return true;
+}
@@ -0,0 +1,124 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+// Logging and tracing for the hot path.
+//
+// Log messages go through FT_LOG_* macros. The level is chosen at runtime (logLevel setting),
+// levels below FT_MIN_LOG_LEVEL are compiled out, so their arguments are never evaluated.
+// Messages are written without flushing the stream.
+//
+// Timers and counters are recorded into a ring buffer per thread, no locks are taken while
+// recording. WriteChromeTrace exports them as Chrome trace JSON (chrome://tracing, Perfetto).
+// Recording is off until EnableTracing(true) is called, with FT_ENABLE_TRACING=0 the macros
+// are compiled out as well.
+
+enum class LogLevel
+{
+    Trace = 0,
+    Debug = 1,
+    Info = 2,
+    Warn = 3,
+    Error = 4,
+    Off = 5
+};
+
+#ifndef FT_MIN_LOG_LEVEL
+#define FT_MIN_LOG_LEVEL 0
+#endif
+
+#ifndef FT_ENABLE_TRACING
+#define FT_ENABLE_TRACING 1
+#endif
+
+void SetLogLevel(LogLevel level);
+LogLevel GetLogLevel();
+bool LogEnabled(LogLevel level);
+// TRACE, DEBUG, INFO, WARN, ERROR or OFF, unknown names give Info
+LogLevel ParseLogLevel(const std::string& name);
+void WriteLog(LogLevel level, const std::string& message);
+
+#define FT_LOG(level, expr)                                                      \
+    do                                                                           \
+    {                                                                            \
+        if ((int)(level) >= FT_MIN_LOG_LEVEL && LogEnabled(level))               \
+        {                                                                        \
+            std::ostringstream ftLogStream_;                                     \
+            ftLogStream_ << expr;                                                \
+            WriteLog(level, ftLogStream_.str());                                 \
+        }                                                                        \
+    } while (0)
+
+#define FT_LOG_TRACE(expr) FT_LOG(LogLevel::Trace, expr)
+#define FT_LOG_DEBUG(expr) FT_LOG(LogLevel::Debug, expr)
+#define FT_LOG_INFO(expr) FT_LOG(LogLevel::Info, expr)
+#define FT_LOG_WARN(expr) FT_LOG(LogLevel::Warn, expr)
+#define FT_LOG_ERROR(expr) FT_LOG(LogLevel::Error, expr)
+
+
+// nanoseconds on a monotonic clock
+inline int64_t TraceNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void EnableTracing(bool enable);
+bool TracingEnabled();
+
+// names must be string literals (or live until the trace is written), only the pointer is stored
+void RecordDuration(const char* name, int64_t startNs, int64_t durationNs);
+void RecordCounter(const char* name, double value);
+
+// Writes all recorded events. Call it when no other thread is recording, e.g. at the end of the run.
+bool WriteChromeTrace(const std::string& filename);
+
+// Times the enclosing scope. The duration is recorded as trace event and, if seconds is given,
+// also stored there, so callers which report stage times don't need a second clock.
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(const char* name, double* seconds = nullptr)
+        : name_m(name), seconds_m(seconds), start_m(TraceNow()) {}
+    ~ScopedTimer()
+    {
+        const int64_t duration = TraceNow() - start_m;
+        if (seconds_m)
+            *seconds_m = 1e-9 * duration;
+        if (FT_ENABLE_TRACING && TracingEnabled())
+            RecordDuration(name_m, start_m, duration);
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    // seconds since construction
+    double Elapsed() const { return 1e-9 * (TraceNow() - start_m); }
+
+private:
+    const char* name_m;
+    double* seconds_m;
+    int64_t start_m;
+};
+
+#define FT_CONCAT_(a, b) a##b
+#define FT_CONCAT(a, b) FT_CONCAT_(a, b)
+
+#if FT_ENABLE_TRACING
+#define FT_SCOPED_TIMER(name) ScopedTimer FT_CONCAT(ftScopedTimer_, __LINE__)(name)
+#define FT_COUNTER(name, value)                  \
+    do                                           \
+    {                                            \
+        if (TracingEnabled())                    \
+            RecordCounter(name, (double)(value)); \
+    } while (0)
+#else
+#define FT_SCOPED_TIMER(name) do {} while (0)
+#define FT_COUNTER(name, value) do {} while (0)
+#endif
+
+#endif /* INSTRUMENTATION_H */
@@ -0,0 +1,97 @@
+#include "MatchSelection.h"
+
+#include <cmath>
+
+using namespace std;
+
+
+void SelectMatches(const vector<vector<cv::DMatch>>& knnMatches, bool bRatioTest, double maxRatio,
+                   const vector<int>& reverseBest, vector<cv::DMatch>& matches, vector<float>* ratios)
+{
+    SelectMatches((int)knnMatches.size(), [&](int q, int& t0, float& d0, int& t1, float& d1) {
+        const vector<cv::DMatch>& kMatches = knnMatches[q];
+        if (kMatches.size() > 0)
+        {
+            t0 = kMatches[0].trainIdx;
+            d0 = kMatches[0].distance;
+        }
+        if (kMatches.size() > 1)
+        {
+            t1 = kMatches[1].trainIdx;
+            d1 = kMatches[1].distance;
+        }
+    }, bRatioTest, maxRatio, reverseBest, matches, ratios);
+}
+
+void SelectMatches(const vector<Best2Match>& best2, bool bRatioTest, double maxRatio,
+                   const vector<int>& reverseBest, vector<cv::DMatch>& matches, vector<float>* ratios)
+{
+    SelectMatches((int)best2.size(), [&](int q, int& t0, float& d0, int& t1, float& d1) {
+        const Best2Match& m = best2[q];
+        t0 = m.trainIdx[0];
+        d0 = (float)m.distance[0];
+        t1 = m.trainIdx[1];
+        d1 = (float)m.distance[1];
+    }, bRatioTest, maxRatio, reverseBest, matches, ratios);
+}
+
+void SelectMatches(const vector<Best2MatchL2>& best2, bool bRatioTest, double maxRatio,
+                   const vector<int>& reverseBest, vector<cv::DMatch>& matches, vector<float>* ratios)
+{
+    SelectMatches((int)best2.size(), [&](int q, int& t0, float& d0, int& t1, float& d1) {
+        const Best2MatchL2& m = best2[q];
+        t0 = m.trainIdx[0];
+        d0 = std::sqrt(m.distSqr[0]);
+        t1 = m.trainIdx[1];
+        d1 = std::sqrt(m.distSqr[1]);
+    }, bRatioTest, maxRatio, reverseBest, matches, ratios);
+}
+
+void SelectMatches(const KnnResult& knn, bool bRatioTest, double maxRatio,
+                   const vector<int>& reverseBest, vector<cv::DMatch>& matches, vector<float>* ratios)
+{
+    SelectMatches(knn.indices.rows, [&](int q, int& t0, float& d0, int& t1, float& d1) {
+        const int* idx = knn.indices.ptr<int>(q);
+        const float* dist = knn.distances.ptr<float>(q);
+        t0 = idx[0];
+        d0 = dist[0];
+        if (knn.indices.cols > 1)
+        {
+            t1 = idx[1];
+            d1 = dist[1];
+        }
+    }, bRatioTest, maxRatio, reverseBest, matches, ratios);
+}
+
+vector<int> BestTrainIdx(const vector<vector<cv::DMatch>>& knnMatches)
+{
+    vector<int> best(knnMatches.size(), -1);
+    for (size_t q = 0; q < knnMatches.size(); q++)
+        if (!knnMatches[q].empty())
+            best[q] = knnMatches[q][0].trainIdx;
+    return best;
+}
+
+vector<int> BestTrainIdx(const vector<Best2Match>& best2)
+{
+    vector<int> best(best2.size());
+    for (size_t q = 0; q < best2.size(); q++)
+        best[q] = best2[q].trainIdx[0];
+    return best;
+}
+
+vector<int> BestTrainIdx(const vector<Best2MatchL2>& best2)
+{
+    vector<int> best(best2.size());
+    for (size_t q = 0; q < best2.size(); q++)
+        best[q] = best2[q].trainIdx[0];
+    return best;
+}
+
+vector<int> BestTrainIdx(const KnnResult& knn)
+{
+    vector<int> best(knn.indices.rows);
+    for (int q = 0; q < knn.indices.rows; q++)
+        best[q] = knn.indices.at<int>(q, 0);
+    return best;
+}
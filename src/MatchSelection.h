@@ -0,0 +1,92 @@
+#ifndef MATCHSELECTION_H
+#define MATCHSELECTION_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "CompactMatcher.h" // Best2MatchL2
+#include "FlannMatcher.h" // KnnResult
+#include "HammingMatcher.h" // Best2Match
+#include "Instrumentation.h"
+
+// Final selection of the matches in one pass over the queries: best candidate, distance ratio
+// test (SEL_KNN) and optional cross check. Every query writes its result into its own slot of the
+// preallocated output, rejected slots are squeezed out at the end.
+// best2(q, t0, d0, t1, d1) gives the two best candidates of query q, t1 stays -1 if there is no
+// second one. reverseBest holds the best query for every train descriptor, empty without cross check.
+// ratios, if given, gets d0 / d1 of every kept match (0 without a second candidate), the margin
+// of the ratio test which orders the matches for geometric verification.
+template <typename Best2Fn>
+void SelectMatches(int numQueries, Best2Fn best2, bool bRatioTest, double maxRatio,
+                   const std::vector<int>& reverseBest, std::vector<cv::DMatch>& matches,
+                   std::vector<float>* ratios = nullptr)
+{
+    matches.resize(numQueries);
+    if (ratios)
+        ratios->resize(numQueries);
+    cv::parallel_for_(cv::Range(0, numQueries), [&](const cv::Range& range) {
+        for (int q = range.start; q < range.end; q++)
+        {
+            int t0 = -1, t1 = -1;
+            float d0 = 0.f, d1 = 0.f;
+            best2(q, t0, d0, t1, d1);
+
+            bool bKeep = t0 >= 0;
+            if (bKeep && bRatioTest && t1 >= 0) // a single candidate is not ambiguous
+                bKeep = d0 <= maxRatio * d1;
+            if (bKeep && !reverseBest.empty())
+                bKeep = reverseBest[t0] == q;
+            matches[q] = bKeep ? cv::DMatch(q, t0, d0) : cv::DMatch();
+            if (ratios)
+                (*ratios)[q] = t1 < 0 ? 0.f : d1 > 0.f ? d0 / d1 : 1.f;
+        }
+    });
+
+    size_t numKept = 0;
+    for (int q = 0; q < numQueries; q++)
+    {
+        if (matches[q].trainIdx < 0)
+            continue;
+        matches[numKept] = matches[q];
+        if (ratios)
+            (*ratios)[numKept] = (*ratios)[q];
+        numKept++;
+    }
+    const size_t numRejected = numQueries - numKept;
+    matches.resize(numKept);
+    if (ratios)
+        ratios->resize(numKept);
+    FT_COUNTER("filter rejects", numRejected);
+    FT_LOG_DEBUG("Filtered out " << numRejected << " ambiguous matches out of " << numQueries << " total.");
+}
+
+// selection on the knn lists of an opencv matcher, k may be 1 or 2
+void SelectMatches(const std::vector<std::vector<cv::DMatch>>& knnMatches, bool bRatioTest, double maxRatio,
+                   const std::vector<int>& reverseBest, std::vector<cv::DMatch>& matches,
+                   std::vector<float>* ratios = nullptr);
+
+// selection on the two best matches found by the hamming matcher
+void SelectMatches(const std::vector<Best2Match>& best2, bool bRatioTest, double maxRatio,
+                   const std::vector<int>& reverseBest, std::vector<cv::DMatch>& matches,
+                   std::vector<float>* ratios = nullptr);
+
+// selection on the two best matches found by the compact matcher, with L2 (not squared) distances
+void SelectMatches(const std::vector<Best2MatchL2>& best2, bool bRatioTest, double maxRatio,
+                   const std::vector<int>& reverseBest, std::vector<cv::DMatch>& matches,
+                   std::vector<float>* ratios = nullptr);
+
+// selection on the nearest neighbours found by the flann matcher
+void SelectMatches(const KnnResult& knn, bool bRatioTest, double maxRatio,
+                   const std::vector<int>& reverseBest, std::vector<cv::DMatch>& matches,
+                   std::vector<float>* ratios = nullptr);
+
+// index of the best train descriptor of every query, -1 if there is none
+std::vector<int> BestTrainIdx(const std::vector<std::vector<cv::DMatch>>& knnMatches);
+std::vector<int> BestTrainIdx(const std::vector<Best2Match>& best2);
+std::vector<int> BestTrainIdx(const std::vector<Best2MatchL2>& best2);
+std::vector<int> BestTrainIdx(const KnnResult& knn);
+
+#endif /* MATCHSELECTION_H */
@@ -14,7 +14,14 @@
 #include "dataStructures.h"
 #include "matching2D.hpp"
 
+#include "BatchProcessor.h"
+#include "BudgetController.h"
+#include "DescriptorCompression.h"
 #include "FeatureTracker.h"
+#include "FramePipeline.h"
+#include "FrameSource.h"
+#include "Instrumentation.h"
+#include "StaticPipeline.h"
 
 #include "util.h"
 
@@ -28,47 +35,106 @@ using namespace std;
 int main(int argc, const char *argv[])
 {
     auto params = LoadParamsFromFile("../src/settings.txt");
+    EnableTracing(!params.traceFile.empty());
 
     /* INIT VARIABLES AND DATA STRUCTURES */
-    // data location
-    string dataPath = "../";
-    // camera
-    string imgBasePath = dataPath + "images/";
-    string imgPrefix = "KITTI/2011_09_26/image_00/data/000000"; // left camera, color
-    string imgFileType = ".png";
-    int imgStartIndex = 0; // first file index to load (assumes Lidar and camera names have identical naming convention)
-    int imgEndIndex = 9;   // last file index to load
-    int imgFillWidth = 4;  // no. of digits which make up the file index (e.g. img-0001.png)
-
-    auto detector = CreateDetector(params.detectorType);
+    // frames of the camera, decoded ahead of the tracker. The source outlives the tracker as
+    // raw sequence frames point into its memory mapping
+    auto source = CreateFrameSource(params);
+    if (source == nullptr)
+    {
+        FT_LOG_ERROR("Failed to open frame source!");
+        return -1;
+    }
+    if (!params.rawExportFile.empty())
+        return WriteRawSequence(*source, params.rawExportFile) > 0 ? 0 : -1;
+    if (params.bLearnDescPca)
+        return LearnDescriptorPca(*source, params) ? 0 : -1;
+
+    auto detector = CreateDetector(params);
     auto descriptor = CreateDescriptor(params.descriptorType);
 
     if (detector == nullptr)
     {
-        cout << "Failed to create detector!" << "\n";
+        FT_LOG_ERROR("Failed to create detector!");
         return -1;
     }
 
+    if (params.batchMode)
+    {
+        BatchProcessor batch(params);
+        vector<BatchFrame> frames = batch.Process(*source);
+
+        // linking the matches into tracks is cheap next to matching, it stays sequential
+        TrackManager tracks(params.trackMaxLost, params.trackMaxHistory);
+        size_t numKeypoints = 0, numMatches = 0;
+        for (const auto& frame : frames)
+        {
+            numKeypoints += frame.features.size();
+            numMatches += frame.matches.size();
+            if (params.bTrackHistory)
+                tracks.Update(frame.features, frame.matches);
+        }
+        FT_LOG_INFO("Batch of " << frames.size() << " frames: " << numKeypoints << " keypoints, " << numMatches
+                    << " matches, " << tracks.size() << " tracks");
+        if (TracingEnabled()) WriteChromeTrace(params.traceFile);
+        return 0;
+    }
+
     FeatureTracker featureTracker(params);
 
-    for (size_t imgIndex = 0; imgIndex <= imgEndIndex - imgStartIndex; imgIndex++)
+    if (params.pipelineMode)
     {
-        /* LOAD IMAGE INTO BUFFER */
-        // assemble filenames for current index
-        ostringstream imgNumber;
-        imgNumber << setfill('0') << setw(imgFillWidth) << imgStartIndex + imgIndex;
-        string imgFullFilename = imgBasePath + imgPrefix + imgNumber.str() + imgFileType;
+        FramePipeline pipeline(params);
+        PipelineStats stats = pipeline.Run(*source, featureTracker);
+        PrintPipelineStats(stats);
+        if (TracingEnabled()) WriteChromeTrace(params.traceFile);
+        return 0;
+    }
+
+    // the static pipeline of the tracker also detects and describes
+    FeaturePipeline* staticPipeline = featureTracker.Pipeline();
 
-        // load image from file and convert to grayscale
-        cv::Mat img, imgGray;
-        img = cv::imread(imgFullFilename);
-        cv::cvtColor(img, imgGray, cv::COLOR_BGR2GRAY);
+    // latencyTargetMs: keypoint budget and detector threshold follow the measured frame times
+    BudgetController budget(params);
+    if (budget.Enabled())
+        params.maxKeypoints = budget.Budget();
+
+    SourceFrame sourceFrame;
+    while (true)
+    {
+        /* LOAD IMAGE INTO BUFFER */
+        // next grayscale frame, waits only if the read-ahead fell behind
+        {
+            FT_SCOPED_TIMER("wait for frame");
+            if (!source->Next(sourceFrame))
+                break;
+        }
+
+        // between keyframes the keypoints are only tracked with optical flow (bKltTracking)
+        if (!featureTracker.NeedsKeyframe())
+        {
+            featureTracker.TrackFeatures(sourceFrame.imgGray);
+            continue;
+        }
 
         // detect and describe features
-        DataFrame frame = DetectAndDescribeFeatures(imgGray, detector, descriptor, params);
+        StageTimes times;
+        DataFrame frame = staticPipeline ? staticPipeline->DetectAndDescribe(sourceFrame.imgGray, &times)
+                                         : DetectAndDescribeFeatures(sourceFrame.imgGray, detector, descriptor, params, &times);
+        const size_t numKeypoints = frame.features.size();
 
         // trackFeatures
-        featureTracker.TrackFeatures(frame);
+        {
+            ScopedTimer timer("track", &times.match);
+            featureTracker.TrackFeatures(std::move(frame));
+        }
+
+        if (budget.Enabled())
+        {
+            budget.Update(times, numKeypoints, *detector);
+            params.maxKeypoints = budget.Budget();
+        }
     }
 
     // refactor above so I can run with every possible combination (30 total)
@@ -79,6 +145,7 @@ int main(int argc, const char *argv[])
     // print out total matches
 
     // print out total time taken
-    
+
+    if (TracingEnabled()) WriteChromeTrace(params.traceFile);
     return 0;
 }
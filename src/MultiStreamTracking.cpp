@@ -0,0 +1,45 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dataStructures.h"
+#include "FrameSource.h"
+#include "Instrumentation.h"
+#include "StreamService.h"
+
+#include "util.h"
+
+using namespace std;
+
+
+// Tracks the camera streams of streamSources side by side on one thread pool
+int main(int argc, const char *argv[])
+{
+    auto params = LoadParamsFromFile("../src/settings.txt");
+    EnableTracing(!params.traceFile.empty());
+
+    vector<string> paths = params.streamSources;
+    if (paths.empty())
+        paths.push_back(params.sourcePath);
+
+    StreamService service(params);
+    for (const auto& path : paths)
+    {
+        // every stream reads its own sequence with the other source settings
+        Params streamParams = params;
+        streamParams.sourcePath = path;
+        auto source = CreateFrameSource(streamParams);
+        if (source == nullptr)
+        {
+            FT_LOG_ERROR("Failed to open frame source " << path << "!");
+            return -1;
+        }
+        service.AddStream(path, std::move(source));
+    }
+
+    ServiceStats stats = service.Run();
+    PrintServiceStats(stats);
+    if (TracingEnabled()) WriteChromeTrace(params.traceFile);
+    return stats.numFrames > 0 ? 0 : -1;
+}
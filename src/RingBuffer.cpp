@@ -1,6 +0,0 @@
-#include "RingBuffer.h"
-
-RingBuffer::RingBuffer(const size_t size) : buf_m(size)
-{
-    
-}
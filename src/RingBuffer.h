@@ -1,17 +1,59 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
 #include <vector>
+#include <utility>
+#include <algorithm>
 
-template
-class<T>
+// Fixed capacity ring buffer. All slots are allocated up front and are reused
+// once the buffer is full: the oldest element is overwritten in place, so
+// members which keep their storage (e.g. vectors that are cleared) are not
+// reallocated for every new element.
+template <typename T>
 class RingBuffer
 {
 public:
-    RingBuffer(const size_t size);
-    size_t capacity() const;
-    size_t size() const;
-    size_t full() const;
-    void load(const T element);
-    T read() const;
+    explicit RingBuffer(const size_t capacity) : buf_m(std::max<size_t>(capacity, 1)) {}
+
+    size_t capacity() const { return buf_m.size(); }
+    size_t size() const { return size_m; }
+    bool empty() const { return size_m == 0; }
+    bool full() const { return size_m == buf_m.size(); }
+
+    // Make room for a new element and return its slot. If the buffer is full
+    // this is the slot of the oldest element, which still holds its old contents.
+    T& recycle()
+    {
+        T& slot = buf_m[head_m];
+        head_m = (head_m + 1) % buf_m.size();
+        if (size_m < buf_m.size())
+            size_m++;
+        return slot;
+    }
+
+    void push(T&& element) { recycle() = std::move(element); }
+    void push(const T& element) { recycle() = element; }
+
+    // access by age, latest(0) is the newest element, latest(size() - 1) the oldest
+    T& latest(const size_t age = 0) { return buf_m[index(age)]; }
+    const T& latest(const size_t age = 0) const { return buf_m[index(age)]; }
+
+    // access in insertion order, 0 is the oldest element
+    T& operator[](const size_t i) { return latest(size_m - 1 - i); }
+    const T& operator[](const size_t i) const { return latest(size_m - 1 - i); }
+
+    void clear()
+    {
+        head_m = 0;
+        size_m = 0;
+    }
+
 private:
-    size_t head_m, tail_m;
+    size_t index(const size_t age) const { return (head_m + buf_m.size() - 1 - age) % buf_m.size(); }
+
+    size_t head_m = 0; // slot that is written next
+    size_t size_m = 0;
     std::vector<T> buf_m;
 };
+
+#endif /* RINGBUFFER_H */
@@ -0,0 +1,49 @@
+#include "SpatialGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+void SpatialGrid::Build(const float* x, const float* y, size_t numPoints, float cellSize)
+{
+    cellSize_m = max(cellSize, 1.0f);
+    points_m.resize(numPoints);
+    cellStart_m.clear();
+    cellPoints_m.clear();
+    if (numPoints == 0)
+        return;
+
+    // bounding box of all points defines the grid
+    cv::Point2f minPt(x[0], y[0]), maxPt(x[0], y[0]);
+    for (size_t i = 0; i < numPoints; i++)
+    {
+        points_m[i] = cv::Point2f(x[i], y[i]);
+        minPt.x = min(minPt.x, points_m[i].x);
+        minPt.y = min(minPt.y, points_m[i].y);
+        maxPt.x = max(maxPt.x, points_m[i].x);
+        maxPt.y = max(maxPt.y, points_m[i].y);
+    }
+    origin_m = minPt;
+    cols_m = CellCoord(maxPt.x, origin_m.x) + 1;
+    rows_m = CellCoord(maxPt.y, origin_m.y) + 1;
+
+    // counting sort of the points by cell
+    vector<int> cellOfPoint(points_m.size());
+    cellStart_m.assign(cols_m * rows_m + 1, 0);
+    for (size_t i = 0; i < points_m.size(); i++)
+    {
+        int cx = min(cols_m - 1, CellCoord(points_m[i].x, origin_m.x));
+        int cy = min(rows_m - 1, CellCoord(points_m[i].y, origin_m.y));
+        cellOfPoint[i] = cy * cols_m + cx;
+        cellStart_m[cellOfPoint[i] + 1]++;
+    }
+    for (size_t c = 1; c < cellStart_m.size(); c++)
+        cellStart_m[c] += cellStart_m[c - 1];
+
+    cellPoints_m.resize(points_m.size());
+    vector<int> fill(cellStart_m.begin(), cellStart_m.end() - 1);
+    for (size_t i = 0; i < points_m.size(); i++)
+        cellPoints_m[fill[cellOfPoint[i]]++] = i;
+}
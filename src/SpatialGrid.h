@@ -0,0 +1,57 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Uniform grid index over keypoint positions. The point indices are stored cell by
+// cell in one array (counting sort), so the points of a cell are contiguous.
+class SpatialGrid
+{
+public:
+    void Build(const float* x, const float* y, size_t numPoints, float cellSize);
+
+    // call f(index) for every point within radius of center
+    template <typename F>
+    void ForEachInRadius(const cv::Point2f& center, float radius, F f) const
+    {
+        if (points_m.empty())
+            return;
+        const float radiusSqr = radius * radius;
+        const int cx0 = std::max(0, CellCoord(center.x - radius, origin_m.x));
+        const int cx1 = std::min(cols_m - 1, CellCoord(center.x + radius, origin_m.x));
+        const int cy0 = std::max(0, CellCoord(center.y - radius, origin_m.y));
+        const int cy1 = std::min(rows_m - 1, CellCoord(center.y + radius, origin_m.y));
+        for (int cy = cy0; cy <= cy1; cy++)
+        {
+            for (int cx = cx0; cx <= cx1; cx++)
+            {
+                const int cell = cy * cols_m + cx;
+                for (int k = cellStart_m[cell]; k < cellStart_m[cell + 1]; k++)
+                {
+                    const int idx = cellPoints_m[k];
+                    const float dx = points_m[idx].x - center.x;
+                    const float dy = points_m[idx].y - center.y;
+                    if (dx * dx + dy * dy <= radiusSqr)
+                        f(idx);
+                }
+            }
+        }
+    }
+
+private:
+    int CellCoord(float v, float origin) const { return (int)std::floor((v - origin) / cellSize_m); }
+
+    float cellSize_m = 1.0f;
+    cv::Point2f origin_m;
+    int cols_m = 0, rows_m = 0;
+    std::vector<cv::Point2f> points_m;
+    std::vector<int> cellStart_m;  // first entry of each cell in cellPoints_m, one extra entry at the end
+    std::vector<int> cellPoints_m; // point indices sorted by cell
+};
+
+#endif /* SPATIALGRID_H */
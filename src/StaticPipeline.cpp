@@ -0,0 +1,262 @@
+#include "StaticPipeline.h"
+
+#include <string>
+
+#include "DescriptorCompression.h" // CompactDescriptors
+#include "Instrumentation.h"
+#include "MatchSelection.h"
+#include "util.h" // CreateDescriptor, LimitFeaturesRect, LimitKeyPointsRect
+
+using namespace std;
+
+
+template <class Descriptor>
+BruteForceMatching<Descriptor>::BruteForceMatching(const Params&) : matcher_m(cv::BFMatcher::create(Descriptor::kNorm, false))
+{
+}
+
+template <class Descriptor>
+template <bool RatioTest>
+void BruteForceMatching<Descriptor>::Match(const cv::Mat& query, const cv::Mat& train, double maxRatio, bool bCrossCheck,
+                                           vector<cv::DMatch>& matches, vector<float>* ratios) const
+{
+    vector<int> reverseBest;
+    if (bCrossCheck)
+    {
+        vector<vector<cv::DMatch>> reverseMatches;
+        matcher_m->knnMatch(train, query, reverseMatches, 1);
+        reverseBest = BestTrainIdx(reverseMatches);
+    }
+    vector<vector<cv::DMatch>> knnMatches;
+    matcher_m->knnMatch(query, train, knnMatches, RatioTest ? 2 : 1);
+    SelectMatches(knnMatches, RatioTest, maxRatio, reverseBest, matches, ratios);
+}
+
+template <class Descriptor>
+FlannMatching<Descriptor>::FlannMatching(const Params& params) : matcher_m(params)
+{
+}
+
+template <class Descriptor>
+template <bool RatioTest>
+void FlannMatching<Descriptor>::Match(const cv::Mat& query, const cv::Mat& train, double maxRatio, bool bCrossCheck,
+                                      vector<cv::DMatch>& matches, vector<float>* ratios)
+{
+    vector<int> reverseBest;
+    KnnResult knn;
+    if (bCrossCheck)
+    {
+        matcher_m.Build(query);
+        matcher_m.KnnSearch(train, 1, knn);
+        reverseBest = BestTrainIdx(knn);
+    }
+    matcher_m.Build(train);
+    matcher_m.KnnSearch(query, RatioTest ? 2 : 1, knn);
+    SelectMatches(knn, RatioTest, maxRatio, reverseBest, matches, ratios);
+}
+
+template <class Descriptor>
+template <bool RatioTest>
+void HammingMatching<Descriptor>::Match(const cv::Mat& query, const cv::Mat& train, double maxRatio, bool bCrossCheck,
+                                        vector<cv::DMatch>& matches, vector<float>* ratios) const
+{
+    vector<int> reverseBest;
+    if (bCrossCheck)
+    {
+        vector<Best2Match> reverseBest2;
+        matcher_m.KnnMatch2(train, query, reverseBest2);
+        reverseBest = BestTrainIdx(reverseBest2);
+    }
+    vector<Best2Match> best2;
+    matcher_m.KnnMatch2(query, train, best2);
+    SelectMatches(best2, RatioTest, maxRatio, reverseBest, matches, ratios);
+}
+
+
+template <class DetectorPolicy, class DescriptorPolicy, template <class> class MatcherPolicy, class SelectorPolicy>
+StaticPipeline<DetectorPolicy, DescriptorPolicy, MatcherPolicy, SelectorPolicy>::StaticPipeline(const Params& params)
+    : descriptor_m(CreateDescriptor(DescriptorPolicy::Name())), // same configuration as the runtime path
+      matcher_m(params),
+      bFused_m(kFused && params.bFusedDetectDescribe),
+      focusRects_m(params.bFocusOnVehicle ? params.focusRects : vector<cv::Rect>()),
+      matchRatio_m(params.matchRatio),
+      bCrossCheck_m(params.bCrossCheck)
+{
+    FT_LOG_DEBUG("Static pipeline " << DetectorPolicy::Name() << "/" << DescriptorPolicy::Name() << "/"
+                << Matcher::Name() << "/" << SelectorPolicy::Name() << (bFused_m ? " (fused)" : ""));
+    if (params.normType != DescriptorPolicy::kNorm)
+        FT_LOG_WARN("normType " << params.normType << " is ignored, " << DescriptorPolicy::Name()
+                    << " descriptors are compared with norm " << (int)DescriptorPolicy::kNorm);
+}
+
+template <class DetectorPolicy, class DescriptorPolicy, template <class> class MatcherPolicy, class SelectorPolicy>
+DataFrame StaticPipeline<DetectorPolicy, DescriptorPolicy, MatcherPolicy, SelectorPolicy>::DetectAndDescribe(const cv::Mat& imgGray, StageTimes* times)
+{
+    vector<cv::KeyPoint> keypoints;
+    cv::Mat descriptors;
+    StageTimes frameTimes;
+    if (bFused_m)
+    {
+        ScopedTimer timer("detect", &frameTimes.detect);
+        detector_m.Detector::DetectAndDescribe(imgGray, keypoints, descriptors);
+        if (!focusRects_m.empty()) LimitFeaturesRect(keypoints, descriptors, focusRects_m);
+    }
+    else
+    {
+        {
+            ScopedTimer timer("detect", &frameTimes.detect);
+            keypoints = detector_m.Detector::DetectKeypoints(imgGray, false);
+            if (!focusRects_m.empty()) LimitKeyPointsRect(keypoints, focusRects_m);
+        }
+        ScopedTimer timer("describe", &frameTimes.describe);
+        descriptor_m->compute(imgGray, keypoints, descriptors);
+    }
+    FT_COUNTER("keypoints", keypoints.size());
+    if (times)
+    {
+        times->detect = frameTimes.detect;
+        times->describe = frameTimes.describe;
+    }
+    return DataFrame(imgGray, keypoints, descriptors);
+}
+
+template <class DetectorPolicy, class DescriptorPolicy, template <class> class MatcherPolicy, class SelectorPolicy>
+vector<cv::DMatch> StaticPipeline<DetectorPolicy, DescriptorPolicy, MatcherPolicy, SelectorPolicy>::Match(const FeatureStore& source, const FeatureStore& ref,
+    vector<float>* ratios)
+{
+    vector<cv::DMatch> matches;
+    if (ratios)
+        ratios->clear();
+    if (source.empty() || ref.empty())
+        return matches;
+    matcher_m.template Match<SelectorPolicy::kRatioTest>(source.descriptors(), ref.descriptors(), matchRatio_m, bCrossCheck_m, matches, ratios);
+    return matches;
+}
+
+
+// The combinations compiled in, each with both selectors. Binary descriptors get the opencv
+// brute force, the native hamming matcher and flann (LSH), float descriptors brute force and flann.
+template class StaticPipeline<FastDetector, BriefDescriptor, BruteForceMatching, SelectNN>;
+template class StaticPipeline<FastDetector, BriefDescriptor, BruteForceMatching, SelectKnn>;
+template class StaticPipeline<FastDetector, BriefDescriptor, HammingMatching, SelectNN>;
+template class StaticPipeline<FastDetector, BriefDescriptor, FlannMatching, SelectNN>;
+template class StaticPipeline<FastDetector, BriefDescriptor, HammingMatching, SelectKnn>;
+template class StaticPipeline<FastDetector, BriefDescriptor, FlannMatching, SelectKnn>;
+template class StaticPipeline<FastDetector, OrbDescriptor, BruteForceMatching, SelectNN>;
+template class StaticPipeline<FastDetector, OrbDescriptor, BruteForceMatching, SelectKnn>;
+template class StaticPipeline<FastDetector, OrbDescriptor, HammingMatching, SelectNN>;
+template class StaticPipeline<FastDetector, OrbDescriptor, FlannMatching, SelectNN>;
+template class StaticPipeline<FastDetector, OrbDescriptor, HammingMatching, SelectKnn>;
+template class StaticPipeline<FastDetector, OrbDescriptor, FlannMatching, SelectKnn>;
+template class StaticPipeline<OrbDetector, OrbDescriptor, BruteForceMatching, SelectNN>;
+template class StaticPipeline<OrbDetector, OrbDescriptor, BruteForceMatching, SelectKnn>;
+template class StaticPipeline<OrbDetector, OrbDescriptor, HammingMatching, SelectNN>;
+template class StaticPipeline<OrbDetector, OrbDescriptor, FlannMatching, SelectNN>;
+template class StaticPipeline<OrbDetector, OrbDescriptor, HammingMatching, SelectKnn>;
+template class StaticPipeline<OrbDetector, OrbDescriptor, FlannMatching, SelectKnn>;
+template class StaticPipeline<OrbDetector, BriskDescriptor, BruteForceMatching, SelectNN>;
+template class StaticPipeline<OrbDetector, BriskDescriptor, BruteForceMatching, SelectKnn>;
+template class StaticPipeline<OrbDetector, BriskDescriptor, HammingMatching, SelectNN>;
+template class StaticPipeline<OrbDetector, BriskDescriptor, FlannMatching, SelectNN>;
+template class StaticPipeline<OrbDetector, BriskDescriptor, HammingMatching, SelectKnn>;
+template class StaticPipeline<OrbDetector, BriskDescriptor, FlannMatching, SelectKnn>;
+template class StaticPipeline<BriskDetector, BriskDescriptor, BruteForceMatching, SelectNN>;
+template class StaticPipeline<BriskDetector, BriskDescriptor, BruteForceMatching, SelectKnn>;
+template class StaticPipeline<BriskDetector, BriskDescriptor, HammingMatching, SelectNN>;
+template class StaticPipeline<BriskDetector, BriskDescriptor, FlannMatching, SelectNN>;
+template class StaticPipeline<BriskDetector, BriskDescriptor, HammingMatching, SelectKnn>;
+template class StaticPipeline<BriskDetector, BriskDescriptor, FlannMatching, SelectKnn>;
+template class StaticPipeline<AkazeDetector, AkazeDescriptor, BruteForceMatching, SelectNN>;
+template class StaticPipeline<AkazeDetector, AkazeDescriptor, BruteForceMatching, SelectKnn>;
+template class StaticPipeline<AkazeDetector, AkazeDescriptor, HammingMatching, SelectNN>;
+template class StaticPipeline<AkazeDetector, AkazeDescriptor, FlannMatching, SelectNN>;
+template class StaticPipeline<AkazeDetector, AkazeDescriptor, HammingMatching, SelectKnn>;
+template class StaticPipeline<AkazeDetector, AkazeDescriptor, FlannMatching, SelectKnn>;
+template class StaticPipeline<SiftDetector, SiftDescriptor, BruteForceMatching, SelectNN>;
+template class StaticPipeline<SiftDetector, SiftDescriptor, BruteForceMatching, SelectKnn>;
+template class StaticPipeline<SiftDetector, SiftDescriptor, FlannMatching, SelectNN>;
+template class StaticPipeline<SiftDetector, SiftDescriptor, FlannMatching, SelectKnn>;
+
+namespace
+{
+
+struct PipelineEntry
+{
+    const char* detector;
+    const char* descriptor;
+    const char* matcher;
+    const char* selector;
+    unique_ptr<FeaturePipeline> (*create)(const Params&);
+};
+
+template <class Pipeline>
+unique_ptr<FeaturePipeline> CreatePipeline(const Params& params)
+{
+    return unique_ptr<FeaturePipeline>(new Pipeline(params));
+}
+
+template <class Det, class Desc, template <class> class Match, class Sel>
+PipelineEntry Entry()
+{
+    return PipelineEntry{Det::Name(), Desc::Name(), Match<Desc>::Name(), Sel::Name(), &CreatePipeline<StaticPipeline<Det, Desc, Match, Sel>>};
+}
+
+template <class Det, class Desc>
+void AddBinary(vector<PipelineEntry>& entries)
+{
+    entries.push_back(Entry<Det, Desc, BruteForceMatching, SelectNN>());
+    entries.push_back(Entry<Det, Desc, BruteForceMatching, SelectKnn>());
+    entries.push_back(Entry<Det, Desc, HammingMatching, SelectNN>());
+    entries.push_back(Entry<Det, Desc, HammingMatching, SelectKnn>());
+    entries.push_back(Entry<Det, Desc, FlannMatching, SelectNN>());
+    entries.push_back(Entry<Det, Desc, FlannMatching, SelectKnn>());
+}
+
+template <class Det, class Desc>
+void AddFloat(vector<PipelineEntry>& entries)
+{
+    entries.push_back(Entry<Det, Desc, BruteForceMatching, SelectNN>());
+    entries.push_back(Entry<Det, Desc, BruteForceMatching, SelectKnn>());
+    entries.push_back(Entry<Det, Desc, FlannMatching, SelectNN>());
+    entries.push_back(Entry<Det, Desc, FlannMatching, SelectKnn>());
+}
+
+// same combinations as the explicit instantiations above
+const vector<PipelineEntry>& PipelineEntries()
+{
+    static const vector<PipelineEntry> entries = []() {
+        vector<PipelineEntry> e;
+        AddBinary<FastDetector, BriefDescriptor>(e);
+        AddBinary<FastDetector, OrbDescriptor>(e);
+        AddBinary<OrbDetector, OrbDescriptor>(e);
+        AddBinary<OrbDetector, BriskDescriptor>(e);
+        AddBinary<BriskDetector, BriskDescriptor>(e);
+        AddBinary<AkazeDetector, AkazeDescriptor>(e);
+        AddFloat<SiftDetector, SiftDescriptor>(e);
+        return e;
+    }();
+    return entries;
+}
+
+} // namespace
+
+unique_ptr<FeaturePipeline> CreateStaticPipeline(const Params& params)
+{
+    if (params.bTiledDetection || (params.bFocusOnVehicle && params.bRoiFirst) || params.bGatedMatching ||
+        (params.bFlannIncremental && params.matcherType == "MAT_FLANN") || params.maxKeypoints > 0 || params.latencyTargetMs > 0 ||
+        !params.featureCacheDir.empty() || CompactDescriptors(params))
+    {
+        FT_LOG_INFO("The settings need the runtime pipeline");
+        return nullptr;
+    }
+
+    for (const auto& entry : PipelineEntries())
+    {
+        if (params.detectorType == entry.detector && params.descriptorType == entry.descriptor &&
+            params.matcherType == entry.matcher && params.selectorType == entry.selector)
+            return entry.create(params);
+    }
+    FT_LOG_INFO("No static pipeline for " << params.detectorType << "/" << params.descriptorType << "/"
+                << params.matcherType << "/" << params.selectorType << ", using the runtime pipeline");
+    return nullptr;
+}
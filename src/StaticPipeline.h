@@ -0,0 +1,204 @@
+#ifndef STATICPIPELINE_H
+#define STATICPIPELINE_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "dataStructures.h" // DataFrame, Params, StageTimes
+#include "FeatureStore.h"
+#include "FlannMatcher.h"
+#include "HammingMatcher.h"
+#include "matching2D.hpp" // detectors
+
+// Detection, description and matching of one detector/descriptor/matcher/selector combination.
+// The settings strings are resolved once, when CreateStaticPipeline picks the combination.
+class FeaturePipeline
+{
+public:
+    virtual ~FeaturePipeline() {}
+
+    virtual DataFrame DetectAndDescribe(const cv::Mat& imgGray, StageTimes* times = nullptr) = 0;
+
+    // matches from the keypoints of source (queryIdx) to ref (trainIdx). ratios, if given, gets the
+    // best to second best distance ratio of every match, as from SelectMatches
+    virtual std::vector<cv::DMatch> Match(const FeatureStore& source, const FeatureStore& ref,
+                                          std::vector<float>* ratios = nullptr) = 0;
+};
+
+
+// detector policies
+struct ShiTomasiDetector { using Type = DetectorShiTomasi; static const char* Name() { return "SHITOMASI"; } };
+struct HarrisDetector    { using Type = DetectorHarris;    static const char* Name() { return "HARRIS"; } };
+struct FastDetector      { using Type = DetectorFast;      static const char* Name() { return "FAST"; } };
+struct BriskDetector     { using Type = DetectorBrisk;     static const char* Name() { return "BRISK"; } };
+struct OrbDetector       { using Type = DetectorOrb;       static const char* Name() { return "ORB"; } };
+struct AkazeDetector     { using Type = DetectorAkaze;     static const char* Name() { return "AKAZE"; } };
+struct SiftDetector      { using Type = DetectorSift;      static const char* Name() { return "SIFT"; } };
+
+// Descriptor policies with the element type and norm of the descriptors. FusedDetector is the
+// detector which computes the same descriptors in its detection pass, void if there is none.
+struct BriskDescriptor
+{
+    static const char* Name() { return "BRISK"; }
+    static constexpr int kDepth = CV_8U;
+    static constexpr int kNorm = cv::NORM_HAMMING;
+    using FusedDetector = BriskDetector;
+};
+
+struct BriefDescriptor
+{
+    static const char* Name() { return "BRIEF"; }
+    static constexpr int kDepth = CV_8U;
+    static constexpr int kNorm = cv::NORM_HAMMING;
+    using FusedDetector = void;
+};
+
+struct OrbDescriptor
+{
+    static const char* Name() { return "ORB"; }
+    static constexpr int kDepth = CV_8U;
+    static constexpr int kNorm = cv::NORM_HAMMING; // WTA_K = 2, the opencv default
+    using FusedDetector = OrbDetector;
+};
+
+struct FreakDescriptor
+{
+    static const char* Name() { return "FREAK"; }
+    static constexpr int kDepth = CV_8U;
+    static constexpr int kNorm = cv::NORM_HAMMING;
+    using FusedDetector = void;
+};
+
+struct AkazeDescriptor
+{
+    static const char* Name() { return "AKAZE"; }
+    static constexpr int kDepth = CV_8U; // MLDB, the opencv default
+    static constexpr int kNorm = cv::NORM_HAMMING;
+    using FusedDetector = AkazeDetector;
+};
+
+struct SiftDescriptor
+{
+    static const char* Name() { return "SIFT"; }
+    static constexpr int kDepth = CV_32F;
+    static constexpr int kNorm = cv::NORM_L2;
+    using FusedDetector = SiftDetector;
+};
+
+// Detector/descriptor pairs which work together, see ValidCombination in TestDifferentSettings.
+// AKAZE descriptors need AKAZE keypoints and the AKAZE detector is only used with them,
+// SIFT keypoints make the ORB descriptor run out of memory.
+template <class Detector, class Descriptor>
+struct CompatibleFeatures
+    : std::integral_constant<bool, std::is_same<Detector, AkazeDetector>::value == std::is_same<Descriptor, AkazeDescriptor>::value &&
+                                   !(std::is_same<Detector, SiftDetector>::value && std::is_same<Descriptor, OrbDescriptor>::value)>
+{
+};
+
+// selector policies
+struct SelectNN  { static constexpr bool kRatioTest = false; static const char* Name() { return "SEL_NN"; } };
+struct SelectKnn { static constexpr bool kRatioTest = true;  static const char* Name() { return "SEL_KNN"; } };
+
+// Matcher policies, constructed from the settings. Match() selects the matches from query to train
+// descriptors with the ratio test if RatioTest is set and keeps only mutual best matches with bCrossCheck.
+// ratios may be nullptr, see SelectMatches.
+template <class Descriptor>
+class BruteForceMatching
+{
+public:
+    static const char* Name() { return "MAT_BF"; }
+    static constexpr bool kBinaryOnly = false;
+
+    explicit BruteForceMatching(const Params& params);
+
+    template <bool RatioTest>
+    void Match(const cv::Mat& query, const cv::Mat& train, double maxRatio, bool bCrossCheck, std::vector<cv::DMatch>& matches,
+               std::vector<float>* ratios) const;
+
+private:
+    cv::Ptr<cv::BFMatcher> matcher_m;
+};
+
+// the flann index type follows from the descriptor type, binary descriptors aren't converted
+template <class Descriptor>
+class FlannMatching
+{
+public:
+    static const char* Name() { return "MAT_FLANN"; }
+    static constexpr bool kBinaryOnly = false;
+
+    explicit FlannMatching(const Params& params);
+
+    // builds the index over train
+    template <bool RatioTest>
+    void Match(const cv::Mat& query, const cv::Mat& train, double maxRatio, bool bCrossCheck, std::vector<cv::DMatch>& matches,
+               std::vector<float>* ratios);
+
+private:
+    FlannMatcher matcher_m;
+};
+
+template <class Descriptor>
+class HammingMatching
+{
+public:
+    static const char* Name() { return "MAT_HAMMING"; }
+    static constexpr bool kBinaryOnly = true;
+
+    explicit HammingMatching(const Params&) {}
+
+    template <bool RatioTest>
+    void Match(const cv::Mat& query, const cv::Mat& train, double maxRatio, bool bCrossCheck, std::vector<cv::DMatch>& matches,
+               std::vector<float>* ratios) const;
+
+private:
+    HammingMatcher matcher_m;
+};
+
+
+// Pipeline of one combination, all calls inside are resolved at compile time and the descriptor
+// type and norm are constants. Combinations which can't work don't compile.
+template <class DetectorPolicy, class DescriptorPolicy, template <class> class MatcherPolicy, class SelectorPolicy>
+class StaticPipeline : public FeaturePipeline
+{
+public:
+    using Detector = typename DetectorPolicy::Type;
+    using Matcher = MatcherPolicy<DescriptorPolicy>;
+
+    static_assert(CompatibleFeatures<DetectorPolicy, DescriptorPolicy>::value,
+                  "the descriptor can't describe the keypoints of this detector");
+    static_assert((DescriptorPolicy::kDepth == CV_8U) == (DescriptorPolicy::kNorm == cv::NORM_HAMMING),
+                  "binary descriptors are compared with the hamming norm, float descriptors with L1 or L2");
+    static_assert(!Matcher::kBinaryOnly || DescriptorPolicy::kDepth == CV_8U,
+                  "the matcher only works on binary descriptors");
+
+    // detector and descriptor build the same scale space and describe in one pass
+    static constexpr bool kFused = std::is_same<DetectorPolicy, typename DescriptorPolicy::FusedDetector>::value;
+
+    StaticPipeline(const Params& params);
+
+    DataFrame DetectAndDescribe(const cv::Mat& imgGray, StageTimes* times = nullptr) override;
+    std::vector<cv::DMatch> Match(const FeatureStore& source, const FeatureStore& ref,
+                                  std::vector<float>* ratios = nullptr) override;
+
+private:
+    Detector detector_m;
+    cv::Ptr<cv::DescriptorExtractor> descriptor_m;
+    Matcher matcher_m;
+    bool bFused_m;
+    std::vector<cv::Rect> focusRects_m; // empty without bFocusOnVehicle
+    double matchRatio_m;
+    bool bCrossCheck_m;
+};
+
+// Pipeline of the combination in the settings, or nullptr if it isn't compiled in or the
+// settings need the runtime path (tiled or roi first detection, a keypoint budget, the feature
+// cache, gated or incremental matching, compact descriptors).
+// normType is not used, the norm belongs to the descriptor.
+std::unique_ptr<FeaturePipeline> CreateStaticPipeline(const Params& params);
+
+#endif /* STATICPIPELINE_H */
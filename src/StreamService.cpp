@@ -0,0 +1,216 @@
+#include "StreamService.h"
+
+#include <iostream>
+#include <map>
+#include <mutex>
+
+#include "Instrumentation.h"
+#include "matching2D.hpp" // KPDetector
+#include "StaticPipeline.h"
+#include "util.h" // DetectAndDescribeFeatures
+
+using namespace std;
+
+
+struct StreamService::Stream
+{
+    Stream(const Params& params, const string& _name, unique_ptr<FrameSource> _source)
+        : source(std::move(_source)), tracker(params)
+    {
+        stats.name = _name;
+    }
+
+    unique_ptr<FrameSource> source;
+    FeatureTracker tracker;
+
+    mutex mutex_;                   // guards the members below
+    map<size_t, DataFrame> described; // described frames waiting for their turn to be matched
+    size_t numRead = 0;             // frames taken from the source
+    size_t nextMatch = 0;           // index of the next frame to be matched
+    bool bReading = false;          // a read task is queued or running
+    bool bMatching = false;         // a match task is queued or running
+    bool bSourceDone = false;
+    StreamStats stats;
+};
+
+struct StreamService::WorkerContext
+{
+    unique_ptr<KPDetector> detector;
+    cv::Ptr<cv::DescriptorExtractor> descriptor;
+    unique_ptr<FeaturePipeline> staticPipeline;
+};
+
+
+StreamService::StreamService(const Params& params)
+    : params_m(params), pool_m(params.streamWorkers, params.bPinThreads)
+{
+    if (params_m.bKltTracking)
+        FT_LOG_WARN("bKltTracking is not used by the stream service, every frame is a keyframe");
+    if (params_m.latencyTargetMs > 0.0)
+        FT_LOG_WARN("latencyTargetMs is not used by the stream service");
+    // the trackers run on the workers, which can't show windows
+    params_m.visualizeMatches = false;
+    contexts_m.resize(pool_m.NumThreads());
+}
+
+StreamService::~StreamService()
+{
+    pool_m.WaitIdle();
+}
+
+size_t StreamService::AddStream(const string& name, unique_ptr<FrameSource> source)
+{
+    streams_m.emplace_back(new Stream(params_m, name, std::move(source)));
+    return streams_m.size() - 1;
+}
+
+FeatureTracker& StreamService::Tracker(size_t stream)
+{
+    return streams_m[stream]->tracker;
+}
+
+ServiceStats StreamService::Run()
+{
+    ServiceStats stats;
+    if (CreateDetector(params_m) == nullptr)
+    {
+        FT_LOG_ERROR("Failed to create detector!");
+        return stats;
+    }
+
+    double t = (double)cv::getTickCount();
+    for (auto& stream : streams_m)
+        ScheduleRead(*stream);
+    pool_m.WaitIdle();
+    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+
+    for (auto& stream : streams_m)
+    {
+        stats.streams.push_back(stream->stats);
+        stats.numFrames += stream->stats.numFrames;
+    }
+    stats.totalTime = t;
+    stats.fps = t > 0.0 ? stats.numFrames / t : 0.0;
+    return stats;
+}
+
+// starts reading unless a read task is already queued or the stream is full
+void StreamService::ScheduleRead(Stream& stream)
+{
+    {
+        lock_guard<mutex> lock(stream.mutex_);
+        if (stream.bReading || stream.bSourceDone || stream.numRead - stream.nextMatch >= (size_t)max(1, params_m.queueCapacity))
+            return;
+        stream.bReading = true;
+    }
+    pool_m.Submit([this, &stream]() { ReadFrames(stream); });
+}
+
+// takes frames from the source until the stream is full, every frame is described by its own task
+void StreamService::ReadFrames(Stream& stream)
+{
+    const size_t capacity = max(1, params_m.queueCapacity);
+    while (true)
+    {
+        {
+            lock_guard<mutex> lock(stream.mutex_);
+            if (stream.numRead - stream.nextMatch >= capacity)
+            {
+                stream.bReading = false;
+                return;
+            }
+        }
+
+        // only this task reads the source
+        SourceFrame frame;
+        bool bHasFrame;
+        {
+            FT_SCOPED_TIMER("wait for frame");
+            bHasFrame = stream.source->Next(frame);
+        }
+
+        lock_guard<mutex> lock(stream.mutex_);
+        if (!bHasFrame)
+        {
+            stream.bSourceDone = true;
+            stream.bReading = false;
+            return;
+        }
+        frame.index = stream.numRead++;
+        pool_m.Submit([this, &stream, frame]() { DescribeFrame(stream, frame); });
+    }
+}
+
+void StreamService::DescribeFrame(Stream& stream, const SourceFrame& frame)
+{
+    WorkerContext& context = Context();
+    DataFrame described = context.staticPipeline ? context.staticPipeline->DetectAndDescribe(frame.imgGray)
+                                                 : DetectAndDescribeFeatures(frame.imgGray, context.detector, context.descriptor, params_m);
+
+    // the frame the stream waits for starts matching, later frames wait in the map
+    {
+        lock_guard<mutex> lock(stream.mutex_);
+        stream.described.emplace(frame.index, std::move(described));
+        if (stream.bMatching || frame.index != stream.nextMatch)
+            return;
+        stream.bMatching = true;
+    }
+    pool_m.Submit([this, &stream]() { MatchFrames(stream); });
+}
+
+// tracks the described frames of the stream in order until the next one is missing
+void StreamService::MatchFrames(Stream& stream)
+{
+    while (true)
+    {
+        DataFrame frame;
+        {
+            lock_guard<mutex> lock(stream.mutex_);
+            auto it = stream.described.find(stream.nextMatch);
+            if (it == stream.described.end())
+            {
+                stream.bMatching = false;
+                return;
+            }
+            frame = std::move(it->second);
+            stream.described.erase(it);
+        }
+
+        const size_t numKeypoints = frame.features.size();
+        const size_t numMatches = stream.tracker.TrackFeatures(std::move(frame)).size();
+        {
+            lock_guard<mutex> lock(stream.mutex_);
+            stream.stats.numFrames++;
+            stream.stats.numKeypoints += numKeypoints;
+            stream.stats.numMatches += numMatches;
+            stream.nextMatch++;
+        }
+        // a frame left the stream, there is room for the next one
+        ScheduleRead(stream);
+    }
+}
+
+// detector, descriptor and static pipeline of the calling worker, only used by this worker
+StreamService::WorkerContext& StreamService::Context()
+{
+    unique_ptr<WorkerContext>& context = contexts_m[WorkStealingPool::CurrentWorker()];
+    if (context == nullptr)
+    {
+        context.reset(new WorkerContext());
+        context->detector = CreateDetector(params_m);
+        context->descriptor = CreateDescriptor(params_m.descriptorType);
+        context->staticPipeline = params_m.bStaticPipeline ? CreateStaticPipeline(params_m) : nullptr;
+    }
+    return *context;
+}
+
+void PrintServiceStats(const ServiceStats& stats)
+{
+    cout << "######### STREAM STATS ##########" << "\n";
+    for (const auto& stream : stats.streams)
+        cout << stream.name << " : " << stream.numFrames << " frames, " << stream.numKeypoints << " keypoints, "
+             << stream.numMatches << " matches" << "\n";
+    cout << "Processed " << stats.numFrames << " frames of " << stats.streams.size() << " streams in "
+         << 1000 * stats.totalTime << " ms (" << stats.fps << " fps)" << "\n";
+    cout << "#################################" << "\n\n";
+}
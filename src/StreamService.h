@@ -0,0 +1,70 @@
+#ifndef STREAMSERVICE_H
+#define STREAMSERVICE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dataStructures.h" // Params
+#include "FeatureTracker.h"
+#include "FrameSource.h"
+#include "WorkStealingPool.h"
+
+struct StreamStats
+{
+    std::string name;
+    size_t numFrames = 0;
+    size_t numKeypoints = 0;
+    size_t numMatches = 0;
+};
+
+struct ServiceStats
+{
+    std::vector<StreamStats> streams;
+    size_t numFrames = 0;   // over all streams
+    double totalTime = 0.0; // wall clock time in seconds
+    double fps = 0.0;       // frames of all streams per second
+};
+
+// Tracks several independent camera streams on one shared WorkStealingPool. Every stream has its
+// own frame source and FeatureTracker. Reading a frame, detecting/describing it and matching it
+// are separate tasks: the frames of all streams are described in parallel by whichever worker is
+// free, while each stream is read and matched by at most one task at a time and matched in frame
+// order, so its tracker sees the same sequence as in the frame by frame loop. Every worker owns
+// its detector, descriptor and static pipeline. At most queueCapacity frames per stream are
+// between reading and matching.
+// Every frame is a keyframe (bKltTracking and latencyTargetMs are not used) and nothing is
+// visualized.
+class StreamService
+{
+public:
+    StreamService(const Params& params);
+    ~StreamService();
+
+    // the source is read from the pool, returns the index of the stream
+    size_t AddStream(const std::string& name, std::unique_ptr<FrameSource> source);
+
+    // tracks every stream to its end
+    ServiceStats Run();
+
+    FeatureTracker& Tracker(size_t stream);
+
+private:
+    struct Stream;
+    struct WorkerContext;
+
+    void ScheduleRead(Stream& stream);
+    void ReadFrames(Stream& stream);
+    void DescribeFrame(Stream& stream, const SourceFrame& frame);
+    void MatchFrames(Stream& stream);
+    WorkerContext& Context();
+
+    Params params_m;
+    std::vector<std::unique_ptr<Stream>> streams_m;
+    std::vector<std::unique_ptr<WorkerContext>> contexts_m; // one per worker, created by the worker
+    WorkStealingPool pool_m; // declared last, the workers stop before the streams go away
+};
+
+void PrintServiceStats(const ServiceStats& stats);
+
+#endif /* STREAMSERVICE_H */
@@ -14,23 +14,18 @@
 #include "dataStructures.h"
 #include "matching2D.hpp"
 #include "FeatureTracker.h"
+#include "FrameSource.h"
+#include "Instrumentation.h"
 #include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <thread>
 
 #include "util.h"
 
 using namespace std;
 
-/* INIT VARIABLES AND DATA STRUCTURES */
-// data location
-string dataPath = "../";
-// camera
-string imgBasePath = dataPath + "images/";
-string imgPrefix = "KITTI/2011_09_26/image_00/data/000000"; // left camera, color
-string imgFileType = ".png";
-int imgStartIndex = 0; // first file index to load (assumes Lidar and camera names have identical naming convention)
-int imgEndIndex = 9;   // last file index to load
-int imgFillWidth = 4;  // no. of digits which make up the file index (e.g. img-0001.png)
-
 bool ValidCombination(const std::string detector, const std::string descriptor)
 {
     if (detector == "AKAZE" && descriptor != "AKAZE")
@@ -46,50 +41,77 @@ bool ValidCombination(const std::string detector, const std::string descriptor)
     return true;
 }
 
-struct Results
+struct FrameResult // timing and counts of one frame in one run
 {
-    double time = 0.0;
+    int run = 0;
+    int frame = 0;
+    StageTimes times;
     int numKeypoints = 0;
     int numMatches = 0;
 };
 
-Results ProcessDatasetWithSettings(const std::unique_ptr<KPDetector>& detector, const cv::Ptr<cv::DescriptorExtractor>& descriptor, const Params& params)
+struct ComboResults
 {
-    FeatureTracker featureTracker(params);
-    double totalTimeForDetectionAndDescription = 0;
-    int totalKeypoints = 0;
-    int totalMatches = 0;
-    
-    // initialize feature tracker
-    for (size_t imgIndex = 0; imgIndex <= imgEndIndex - imgStartIndex; imgIndex++)
+    std::string detector;
+    std::string descriptor;
+    std::vector<FrameResult> frames; // all measured frames of all runs, warm-up runs are not included
+};
+
+// read every frame of the source once, all combinations work on these shared images. The load
+// time is the time the benchmark waits for a frame, decoding ahead of it is not counted. It is
+// measured once per frame here and not in the runs of the combinations
+std::vector<cv::Mat> LoadDataset(FrameSource& source, std::vector<double>& loadTimes)
+{
+    std::vector<cv::Mat> images;
+    SourceFrame frame;
+    while (true)
     {
-        /* LOAD IMAGE INTO BUFFER */
-        // assemble filenames for current index
-        ostringstream imgNumber;
-        imgNumber << setfill('0') << setw(imgFillWidth) << imgStartIndex + imgIndex;
-        string imgFullFilename = imgBasePath + imgPrefix + imgNumber.str() + imgFileType;
+        double t = 0.0;
+        {
+            ScopedTimer timer("wait for frame", &t);
+            if (!source.Next(frame))
+                break;
+        }
+        loadTimes.push_back(t);
+        images.push_back(frame.imgGray);
+    }
+    return images;
+}
 
-        // load image from file and convert to grayscale
-        cv::Mat img, imgGray;
-        img = cv::imread(imgFullFilename);
-        cv::cvtColor(img, imgGray, cv::COLOR_BGR2GRAY);
+void ProcessDatasetWithSettings(const std::vector<cv::Mat>& images,
+                                const Params& params,
+                                int run,
+                                ComboResults& results)
+{
+    auto detector = CreateDetector(params);
+    auto descriptor = CreateDescriptor(params.descriptorType);
+    if (detector == nullptr)
+    {
+        FT_LOG_ERROR("Failed to create detector!");
+        return;
+    }
+
+    FeatureTracker featureTracker(params);
+    for (size_t imgIndex = 0; imgIndex < images.size(); imgIndex++)
+    {
+        FrameResult frameResult;
+        frameResult.run = run;
+        frameResult.frame = imgIndex;
 
         // detect and describe features
-        double t = (double)cv::getTickCount();
-        DataFrame frame = DetectAndDescribeFeatures(imgGray, detector, descriptor, params);
-        t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
-        totalTimeForDetectionAndDescription += t;
-        totalKeypoints += frame.keypoints.size();
-        
-        vector<cv::DMatch> matches = featureTracker.TrackFeatures(frame);
-        totalMatches += matches.size();
+        DataFrame frame = DetectAndDescribeFeatures(images[imgIndex], detector, descriptor, params, &frameResult.times);
+        frameResult.numKeypoints = frame.features.size();
+
+        vector<cv::DMatch> matches;
+        {
+            ScopedTimer timer("track", &frameResult.times.match);
+            matches = featureTracker.TrackFeatures(std::move(frame));
+        }
+        frameResult.numMatches = matches.size();
+
+        if (run >= 0) // negative runs are warm-up runs
+            results.frames.push_back(frameResult);
     }
-    Results results;
-    results.time = totalTimeForDetectionAndDescription;
-    results.numKeypoints = totalKeypoints;
-    results.numMatches = totalMatches;
-    
-    return results;
 }
 
 std::set<std::pair<std::string, std::string>> FormCombinations(std::set<std::string> availableDetectors, std::set<std::string> availableDescriptors)
@@ -111,24 +133,90 @@ std::set<std::pair<std::string, std::string>> FormCombinations(std::set<std::str
     return combinations;
 }
 
-void WriteResultsToDisk(std::string detector, std::string descriptor, double processingTime, int numberKeypoints, int totalMatches)
+// nearest rank percentile of a sorted list
+double Percentile(const std::vector<double>& sorted, double p)
 {
-    std::string filename = "/tmp/results.txt";
-    std::ofstream file(filename, ios::out | ios::app);
-    if (file.is_open())
+    if (sorted.empty())
+        return 0.0;
+    size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+// one summary line, samples in ms
+void WriteStageSummary(std::ofstream& file, const std::string& detector, const std::string& descriptor,
+                       const std::string& stage, std::vector<double> samples, double keypoints, double matches)
+{
+    std::sort(samples.begin(), samples.end());
+    double mean = samples.empty() ? 0.0 : std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+
+    file << detector << "," << descriptor << "," << stage << "," << samples.size() << ","
+         << mean << "," << Percentile(samples, 0) << "," << Percentile(samples, 50) << ","
+         << Percentile(samples, 90) << "," << Percentile(samples, 99) << "," << Percentile(samples, 100) << ","
+         << keypoints << "," << matches << "\n";
+}
+
+// the load stage is shared by all combinations and written once, as detector and descriptor ALL
+void WriteSummaryToDisk(const std::string& filename, const std::vector<double>& loadTimes,
+                        const std::vector<ComboResults>& allResults)
+{
+    std::ofstream file(filename, ios::out);
+    if (!file.is_open())
     {
-    // Write below to a results file
-        file << "\n\nDetector/Descriptor: " << detector << ", " << descriptor << endl;
-    // print out total number of keypoints detected on vehicle (all 10 images)
-        file << "Total keypoints: " << numberKeypoints << endl;
-    // print out total matches
-        file << "Total matches: " << totalMatches << endl;
-    // print out total time taken
-        file << "Total time for detection and description: " << processingTime << endl;
-        file.close();
+        FT_LOG_ERROR("unable to open " << filename);
+        return;
     }
-    else {
-        cout << "unable to open " << filename << "\n";
+
+    file << "detector,descriptor,stage,samples,mean_ms,min_ms,p50_ms,p90_ms,p99_ms,max_ms,keypoints_per_frame,matches_per_frame\n";
+    std::vector<double> loadSamples;
+    for (auto t : loadTimes)
+        loadSamples.push_back(1000 * t);
+    WriteStageSummary(file, "ALL", "ALL", "load", loadSamples, 0.0, 0.0);
+
+    const std::vector<std::pair<std::string, double StageTimes::*>> stages =
+        {{"detect", &StageTimes::detect}, {"describe", &StageTimes::describe}, {"match", &StageTimes::match}};
+    for (const auto& res : allResults)
+    {
+        double keypoints = 0.0, matches = 0.0;
+        for (const auto& f : res.frames)
+        {
+            keypoints += f.numKeypoints;
+            matches += f.numMatches;
+        }
+        if (!res.frames.empty())
+        {
+            keypoints /= res.frames.size();
+            matches /= res.frames.size();
+        }
+
+        for (const auto& stage : stages)
+        {
+            std::vector<double> samples;
+            for (const auto& f : res.frames)
+                samples.push_back(1000 * (f.times.*stage.second));
+            WriteStageSummary(file, res.detector, res.descriptor, stage.first, samples, keypoints, matches);
+        }
+    }
+}
+
+void WriteFramesToDisk(const std::string& filename, const std::vector<ComboResults>& allResults)
+{
+    std::ofstream file(filename, ios::out);
+    if (!file.is_open())
+    {
+        FT_LOG_ERROR("unable to open " << filename);
+        return;
+    }
+
+    file << "detector,descriptor,run,frame,detect_ms,describe_ms,match_ms,keypoints,matches\n";
+    for (const auto& res : allResults)
+    {
+        for (const auto& f : res.frames)
+        {
+            file << res.detector << "," << res.descriptor << "," << f.run << "," << f.frame << ","
+                 << 1000 * f.times.detect << ","
+                 << 1000 * f.times.describe << "," << 1000 * f.times.match << ","
+                 << f.numKeypoints << "," << f.numMatches << "\n";
+        }
     }
 }
 
@@ -137,7 +225,14 @@ void WriteResultsToDisk(std::string detector, std::string descriptor, double pro
 int main(int argc, const char *argv[])
 {
     Params params = LoadParamsFromFile("../src/settings.txt");
-    params.cvWaitTime = 10;
+    params.visualizeMatches = false; // combinations run in parallel, no windows
+    if (!params.featureCacheDir.empty())
+    {
+        // the warm-up runs would fill the cache and every measured run would load its features
+        FT_LOG_INFO("featureCacheDir is ignored, the benchmark measures detection and description");
+        params.featureCacheDir.clear();
+    }
+    EnableTracing(!params.traceFile.empty());
 
     // make list of strings of possible detectors and descriptors
     std::set<std::string> availableDetectors = {"HARRIS", "FAST", "SHITOMASI", "BRISK", "ORB", "AKAZE", "SIFT"};
@@ -145,36 +240,57 @@ int main(int argc, const char *argv[])
 
     // make pairs of all possible combinations. Don't use invalid pairs
     auto combinations = FormCombinations(availableDetectors, availableDescriptors);
+    std::vector<std::pair<std::string, std::string>> comboList(combinations.begin(), combinations.end());
 
-    
-    std::string filename = "/tmp/results.txt";
-    std::ofstream file(filename, ios::out);
-    file << "RESULTS OF FEATURE TRACKING\n\n";
-    file.close();
-
-    // process dataset with each combination
-    for (auto& combo : combinations)
+    // decode the dataset once and share it between all combinations. The source stays alive
+    // until the end, raw sequence frames point into its memory mapping
+    auto source = CreateFrameSource(params);
+    if (source == nullptr)
     {
-        cout << "\n\n\n";
-        cout << "################################################## \n";
-        cout << "### Running with " << combo.first << " and " << combo.second << "\n";
-        cout << "################################################## \n\n ";
-        auto detector = CreateDetector(combo.first);
-        auto descriptor = CreateDescriptor(combo.second);
-    
-        if (detector == nullptr)
-        {
-            cout << "Failed to create detector!" << "\n";
-            return -1;
-        }
+        FT_LOG_ERROR("Failed to open frame source!");
+        return -1;
+    }
+    std::vector<double> loadTimes;
+    const std::vector<cv::Mat> images = LoadDataset(*source, loadTimes);
+
+    int numThreads = params.benchThreads > 0 ? params.benchThreads : std::max(1u, std::thread::hardware_concurrency());
+    numThreads = std::min<int>(numThreads, comboList.size());
+    if (numThreads > 1)
+        cv::setNumThreads(1); // the combinations already use all cores, avoid oversubscription inside opencv
 
-        params.detectorType=combo.first;
-        params.descriptorType=combo.second;
-        if (combo.second == "SIFT") params.normType=4; // use L2 norm instead of hamming for gradient descriptors 
+    cout << "Running " << comboList.size() << " combinations on " << numThreads << " threads with "
+         << params.benchWarmupRuns << " warm-up and " << params.benchRuns << " measured runs" << "\n";
 
-        Results res = ProcessDatasetWithSettings(detector, descriptor, params);
+    // process dataset with each combination, every thread takes the next combination which is not done yet
+    std::vector<ComboResults> allResults(comboList.size());
+    std::atomic<size_t> nextCombo(0);
+    std::vector<std::thread> workers;
+    for (int w = 0; w < numThreads; w++)
+    {
+        workers.emplace_back([&]() {
+            for (size_t c = nextCombo++; c < comboList.size(); c = nextCombo++)
+            {
+                const auto& combo = comboList[c];
+                Params comboParams = params;
+                comboParams.detectorType = combo.first;
+                comboParams.descriptorType = combo.second;
+                if (combo.second == "SIFT") comboParams.normType = cv::NORM_L2; // use L2 norm instead of hamming for gradient descriptors
+                else comboParams.normType = cv::NORM_HAMMING;
+
+                ComboResults& res = allResults[c];
+                res.detector = combo.first;
+                res.descriptor = combo.second;
+                for (int run = -params.benchWarmupRuns; run < params.benchRuns; run++)
+                    ProcessDatasetWithSettings(images, comboParams, run, res);
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
 
-        WriteResultsToDisk(combo.first, combo.second, res.time, res.numKeypoints, res.numMatches);
-    }        
+    WriteSummaryToDisk(params.benchOutput + ".csv", loadTimes, allResults);
+    WriteFramesToDisk(params.benchOutput + "_frames.csv", allResults);
+    cout << "Results written to " << params.benchOutput << ".csv and " << params.benchOutput << "_frames.csv" << "\n";
+    if (TracingEnabled()) WriteChromeTrace(params.traceFile);
     return 0;
 }
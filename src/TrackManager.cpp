@@ -0,0 +1,170 @@
+#include "TrackManager.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+
+TrackManager::TrackManager(int maxLost, int maxHistory)
+    : maxLost_m(max(0, maxLost)), maxHistory_m(max(1, maxHistory))
+{
+}
+
+void TrackManager::Clear()
+{
+    *this = TrackManager(maxLost_m, maxHistory_m);
+}
+
+int32_t TrackManager::AddObservation(int32_t prev, float x, float y)
+{
+    obsX_m.push_back(x);
+    obsY_m.push_back(y);
+    obsFrame_m.push_back(frame_m);
+    obsPrev_m.push_back(prev);
+    return (int32_t)obsX_m.size() - 1;
+}
+
+void TrackManager::Update(const FeatureStore& features, const vector<cv::DMatch>& matches)
+{
+    frame_m++;
+    const size_t numKeypoints = features.size();
+    const vector<int32_t> prevTrackOfKeypoint = std::move(trackOfKeypoint_m);
+
+    // continue the tracks of the matched keypoints. A keypoint of the previous frame may be
+    // matched to several new keypoints (matching without cross check), and two keypoints of the
+    // previous frame may be matched to the same new keypoint. In both cases only the better match
+    // continues the track, so a track gets at most one observation per frame
+    bestMatch_m.assign(prevTrackOfKeypoint.size(), -1);
+    for (size_t i = 0; i < matches.size(); i++)
+    {
+        const auto& m = matches[i];
+        if (m.queryIdx < 0 || m.queryIdx >= (int)prevTrackOfKeypoint.size() || m.trainIdx < 0 || m.trainIdx >= (int)numKeypoints)
+            continue;
+        int32_t& best = bestMatch_m[m.queryIdx];
+        if (best < 0 || m.distance < matches[best].distance)
+            best = (int32_t)i;
+    }
+
+    trackOfKeypoint_m.assign(numKeypoints, -1);
+    bestDistance_m.assign(numKeypoints, numeric_limits<float>::max());
+    for (size_t k = 0; k < prevTrackOfKeypoint.size(); k++)
+    {
+        const int32_t track = prevTrackOfKeypoint[k];
+        if (track < 0 || bestMatch_m[k] < 0)
+            continue;
+        const auto& m = matches[bestMatch_m[k]];
+        if (m.distance < bestDistance_m[m.trainIdx])
+        {
+            trackOfKeypoint_m[m.trainIdx] = track;
+            bestDistance_m[m.trainIdx] = m.distance;
+        }
+    }
+
+    fill(keypoint_m.begin(), keypoint_m.end(), -1);
+    for (size_t k = 0; k < numKeypoints; k++)
+    {
+        int32_t track = trackOfKeypoint_m[k];
+        if (track < 0)
+        {
+            // new track
+            track = (int32_t)id_m.size();
+            id_m.push_back(nextId_m++);
+            firstFrame_m.push_back(frame_m);
+            lastFrame_m.push_back(frame_m);
+            length_m.push_back(0);
+            keypoint_m.push_back(-1);
+            lastObs_m.push_back(-1);
+            trackOfKeypoint_m[k] = track;
+        }
+        lastFrame_m[track] = frame_m;
+        length_m[track]++;
+        keypoint_m[track] = (int32_t)k;
+        lastObs_m[track] = AddObservation(lastObs_m[track], features.x()[k], features.y()[k]);
+    }
+
+    RemoveLostTracks();
+
+    // observations of removed tracks and history beyond maxHistory are dropped once they make up
+    // half of the table, so it stays proportional to the live history
+    size_t liveObservations = 0;
+    for (auto length : length_m)
+        liveObservations += min(length, maxHistory_m);
+    if (obsX_m.size() > 2 * liveObservations + 1024)
+        CompactObservations();
+}
+
+void TrackManager::RemoveLostTracks()
+{
+    // stable compaction of all track arrays, keypoints are pointed at the new positions
+    vector<int32_t> remap(id_m.size(), -1);
+    size_t numKept = 0;
+    for (size_t t = 0; t < id_m.size(); t++)
+    {
+        if (frame_m - lastFrame_m[t] > maxLost_m)
+            continue;
+        remap[t] = (int32_t)numKept;
+        id_m[numKept] = id_m[t];
+        firstFrame_m[numKept] = firstFrame_m[t];
+        lastFrame_m[numKept] = lastFrame_m[t];
+        length_m[numKept] = length_m[t];
+        keypoint_m[numKept] = keypoint_m[t];
+        lastObs_m[numKept] = lastObs_m[t];
+        numKept++;
+    }
+    if (numKept == id_m.size())
+        return;
+
+    id_m.resize(numKept);
+    firstFrame_m.resize(numKept);
+    lastFrame_m.resize(numKept);
+    length_m.resize(numKept);
+    keypoint_m.resize(numKept);
+    lastObs_m.resize(numKept);
+    for (auto& track : trackOfKeypoint_m)
+        track = remap[track]; // tracks of the latest frame are never removed
+}
+
+void TrackManager::CompactObservations()
+{
+    vector<float> obsX, obsY;
+    vector<int32_t> obsFrame, obsPrev;
+    const size_t reserve = min(obsX_m.size(), (size_t)maxHistory_m * id_m.size());
+    obsX.reserve(reserve);
+    obsY.reserve(reserve);
+    obsFrame.reserve(reserve);
+    obsPrev.reserve(reserve);
+
+    vector<int32_t> chain;
+    for (size_t t = 0; t < id_m.size(); t++)
+    {
+        // newest maxHistory observations of the track, copied oldest first
+        chain.clear();
+        for (int32_t obs = lastObs_m[t]; obs >= 0 && (int)chain.size() < maxHistory_m; obs = obsPrev_m[obs])
+            chain.push_back(obs);
+
+        int32_t prev = -1;
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+        {
+            obsX.push_back(obsX_m[*it]);
+            obsY.push_back(obsY_m[*it]);
+            obsFrame.push_back(obsFrame_m[*it]);
+            obsPrev.push_back(prev);
+            prev = (int32_t)obsX.size() - 1;
+        }
+        lastObs_m[t] = prev;
+    }
+
+    obsX_m.swap(obsX);
+    obsY_m.swap(obsY);
+    obsFrame_m.swap(obsFrame);
+    obsPrev_m.swap(obsPrev);
+}
+
+vector<cv::Point2f> TrackManager::History(size_t track) const
+{
+    vector<cv::Point2f> history;
+    ForEachObservation(track, [&](int32_t, const cv::Point2f& pt) { history.push_back(pt); });
+    reverse(history.begin(), history.end());
+    return history;
+}
@@ -0,0 +1,84 @@
+#ifndef TRACKMANAGER_H
+#define TRACKMANAGER_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "FeatureStore.h"
+
+// Feature tracks over many frames. Every keypoint of the latest frame belongs to a track with
+// a persistent id: matched keypoints continue the track of their keypoint in the previous frame,
+// the others start a new track. Tracks which are not continued are kept for maxLost frames, so
+// their history is still available, and removed afterwards.
+//
+// Tracks are stored as structure of arrays, track t is entry t of every array. The positions
+// are stored in an observation table, every observation links to the previous observation of
+// the same track, so the history is walked without searching. At most maxHistory observations
+// are kept per track.
+class TrackManager
+{
+public:
+    TrackManager(int maxLost = 2, int maxHistory = 30);
+
+    // matches of the new frame against the previous frame, queryIdx is the keypoint in the
+    // previous frame and trainIdx the keypoint in the new frame
+    void Update(const FeatureStore& features, const std::vector<cv::DMatch>& matches);
+    void Clear();
+
+    int FrameNumber() const { return frame_m; } // number of the latest frame, the first frame is 0
+    size_t size() const { return id_m.size(); }
+
+    const std::vector<uint64_t>& Ids() const { return id_m; }
+    const std::vector<int32_t>& FirstFrames() const { return firstFrame_m; }
+    const std::vector<int32_t>& LastFrames() const { return lastFrame_m; }  // frame of the newest observation
+    const std::vector<int32_t>& Lengths() const { return length_m; }        // no. of observations, including dropped history
+    const std::vector<int32_t>& Keypoints() const { return keypoint_m; }    // keypoint in the latest frame, -1 if lost
+
+    // track of every keypoint of the latest frame
+    const std::vector<int32_t>& TrackOfKeypoint() const { return trackOfKeypoint_m; }
+
+    // calls f(frame, position) for the last maxHistory observations of a track, newest first
+    template <typename Func>
+    void ForEachObservation(size_t track, Func f) const
+    {
+        int n = 0;
+        for (int32_t obs = lastObs_m[track]; obs >= 0 && n < maxHistory_m; obs = obsPrev_m[obs], n++)
+            f(obsFrame_m[obs], cv::Point2f(obsX_m[obs], obsY_m[obs]));
+    }
+
+    // stored positions of a track, oldest first
+    std::vector<cv::Point2f> History(size_t track) const;
+
+private:
+    int32_t AddObservation(int32_t prev, float x, float y);
+    void RemoveLostTracks();
+    void CompactObservations();
+
+    int maxLost_m;
+    int maxHistory_m;
+    int frame_m = -1;
+    uint64_t nextId_m = 0;
+
+    // tracks
+    std::vector<uint64_t> id_m;
+    std::vector<int32_t> firstFrame_m;
+    std::vector<int32_t> lastFrame_m;
+    std::vector<int32_t> length_m;
+    std::vector<int32_t> keypoint_m;
+    std::vector<int32_t> lastObs_m;
+
+    // observations
+    std::vector<float> obsX_m;
+    std::vector<float> obsY_m;
+    std::vector<int32_t> obsFrame_m;
+    std::vector<int32_t> obsPrev_m;
+
+    std::vector<int32_t> trackOfKeypoint_m;
+    std::vector<float> bestDistance_m; // scratch, best match distance per new keypoint
+    std::vector<int32_t> bestMatch_m;  // scratch, best match per keypoint of the previous frame
+};
+
+#endif /* TRACKMANAGER_H */
@@ -0,0 +1,140 @@
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "Instrumentation.h"
+
+using namespace std;
+
+namespace
+{
+
+thread_local int tCurrentWorker = -1;
+thread_local const WorkStealingPool* tCurrentPool = nullptr;
+
+void PinToCore(thread& th, int core)
+{
+#if defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    if (pthread_setaffinity_np(th.native_handle(), sizeof(cpus), &cpus) != 0)
+        FT_LOG_WARN("Unable to pin worker thread to core " << core);
+#else
+    FT_LOG_WARN("Thread pinning is only supported on linux");
+#endif
+}
+
+} // namespace
+
+
+WorkStealingPool::WorkStealingPool(int numThreads, bool bPinThreads) : queued_m(0), nextQueue_m(0)
+{
+    const int numCores = max(1, (int)thread::hardware_concurrency());
+    const int n = numThreads > 0 ? numThreads : numCores;
+    for (int i = 0; i < n; i++)
+        queues_m.emplace_back(new TaskQueue());
+    for (int i = 0; i < n; i++)
+    {
+        threads_m.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+        if (bPinThreads)
+            PinToCore(threads_m.back(), i % numCores);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        lock_guard<mutex> lock(mutex_m);
+        bStop_m = true;
+    }
+    wake_m.notify_all();
+    for (auto& th : threads_m)
+        th.join();
+}
+
+int WorkStealingPool::CurrentWorker()
+{
+    return tCurrentWorker;
+}
+
+void WorkStealingPool::Submit(function<void()> task)
+{
+    // counted before it is queued, so neither WaitIdle nor a worker taking it sees a count which
+    // doesn't include it. A worker woken in between retries until the task is in its deque.
+    {
+        lock_guard<mutex> lock(mutex_m);
+        pending_m++;
+        queued_m++;
+    }
+
+    const size_t index = tCurrentPool == this ? tCurrentWorker : nextQueue_m++ % queues_m.size();
+    {
+        lock_guard<mutex> lock(queues_m[index]->mutex);
+        queues_m[index]->tasks.push_back(std::move(task));
+    }
+    wake_m.notify_one();
+}
+
+void WorkStealingPool::WaitIdle()
+{
+    unique_lock<mutex> lock(mutex_m);
+    idle_m.wait(lock, [this] { return pending_m == 0; });
+}
+
+// newest task of the own deque, otherwise the oldest task of the next deque which has one
+bool WorkStealingPool::TryPop(int index, function<void()>& task)
+{
+    const int n = (int)queues_m.size();
+    for (int i = 0; i < n; i++)
+    {
+        TaskQueue& queue = *queues_m[(index + i) % n];
+        lock_guard<mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+        if (i == 0)
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            FT_COUNTER("stolen tasks", 1);
+        }
+        queued_m--;
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::WorkerLoop(int index)
+{
+    tCurrentWorker = index;
+    tCurrentPool = this;
+    function<void()> task;
+    while (true)
+    {
+        if (TryPop(index, task))
+        {
+            task();
+            task = nullptr; // release the captures before the task counts as finished
+
+            lock_guard<mutex> lock(mutex_m);
+            if (--pending_m == 0)
+                idle_m.notify_all();
+            continue;
+        }
+
+        unique_lock<mutex> lock(mutex_m);
+        wake_m.wait(lock, [this] { return bStop_m || queued_m > 0; });
+        if (bStop_m && queued_m == 0)
+            return;
+    }
+}
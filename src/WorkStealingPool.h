@@ -0,0 +1,60 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Thread pool where every worker has its own task deque. A worker runs the newest task of its
+// own deque first, so a task submitted from a task runs next on the same core while its data is
+// still in the cache, and steals the oldest task of another worker when its deque is empty.
+// Tasks submitted from outside the pool are spread over the deques round robin.
+class WorkStealingPool
+{
+public:
+    // numThreads 0 uses all cores. bPinThreads pins worker i to core i (modulo the no. of
+    // cores), only on linux
+    WorkStealingPool(int numThreads, bool bPinThreads);
+    ~WorkStealingPool(); // runs the queued tasks to the end
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void Submit(std::function<void()> task);
+
+    // blocks until every submitted task, including the tasks submitted by tasks, has finished
+    void WaitIdle();
+
+    int NumThreads() const { return (int)threads_m.size(); }
+
+    // index of the worker running the calling thread, -1 outside the pool
+    static int CurrentWorker();
+
+private:
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void WorkerLoop(int index);
+    bool TryPop(int index, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<TaskQueue>> queues_m;
+    std::vector<std::thread> threads_m;
+
+    std::mutex mutex_m;               // guards the counters below for the condition variables
+    std::condition_variable wake_m;   // a task was queued or the pool stops
+    std::condition_variable idle_m;   // the last pending task finished
+    std::atomic<size_t> queued_m;     // tasks in the deques
+    size_t pending_m = 0;             // tasks submitted and not finished
+    bool bStop_m = false;
+    std::atomic<unsigned> nextQueue_m;
+};
+
+#endif /* WORKSTEALINGPOOL_H */
@@ -1,23 +1,42 @@
 #ifndef dataStructures_h
 #define dataStructures_h
 
+#include <string>
 #include <vector>
+#include <utility>
 #include <opencv2/core.hpp>
 
+#include "FeatureStore.h"
+
 
 struct DataFrame { // represents the available sensor information at the same time instance
 
-    DataFrame(cv::Mat img, std::vector<cv::KeyPoint> keypts, cv::Mat des) : cameraImg(img),
-                                                                            keypoints(keypts),
-                                                                            descriptors(des)
+    DataFrame() {}
+    DataFrame(cv::Mat img, const std::vector<cv::KeyPoint>& keypts, const cv::Mat& des) : cameraImg(img),
+                                                                                          features(keypts, des)
         {
         }
 
+    // frames are only moved, keypoints and descriptors are never copied
+    DataFrame(DataFrame&&) = default;
+    DataFrame& operator=(DataFrame&&) = default;
+    DataFrame(const DataFrame&) = delete;
+    DataFrame& operator=(const DataFrame&) = delete;
+
     cv::Mat cameraImg; // camera image
-    std::vector<cv::KeyPoint> keypoints; // 2D keypoints within camera image
-    cv::Mat descriptors; // keypoint descriptors
+    FeatureStore features; // 2D keypoints within camera image and their descriptors, in one allocation
     std::vector<cv::DMatch> kptMatches; // keypoint matches between previous and current frame
+    std::vector<cv::Mat> pyramid; // optical flow pyramid of the camera image, only built for bKltTracking
+};
+
+struct StageTimes // processing time of the stages of one frame in seconds
+{
+    double load = 0.0;
+    double detect = 0.0;
+    double describe = 0.0;
+    double match = 0.0;
 };
+
 struct Params
 {
     std::string detectorType;
@@ -25,9 +44,79 @@ struct Params
     std::string matcherType;
     std::string selectorType;
     bool bFocusOnVehicle = true;
+    std::vector<cv::Rect> focusRects = {cv::Rect(535, 180, 180, 150)}; // regions used if bFocusOnVehicle is set
+    bool bRoiFirst = false; // detect and describe only inside the padded focus regions instead of the full image
+    int roiPadding = 50;    // border in pixels added around each focus region in bRoiFirst mode
     int normType;
     bool visualizeMatches = true;
     int cvWaitTime = 0; // amount of time to wait before closing opencv window. If 0, wait until user presses key
+    std::string featureCacheDir = ""; // directory of the on-disk feature cache, empty = no cache
+    int maxKeypoints = 0;         // keep only the strongest keypoints of a frame (of a focus region with bRoiFirst), 0 = no limit
+    double latencyTargetMs = 0.0; // adapt maxKeypoints and the detector threshold so a frame takes this long, 0 = off
+    int budgetMin = 100;          // range of maxKeypoints with latencyTargetMs
+    int budgetMax = 5000;
+    bool bStaticPipeline = true; // use the compiled-in pipeline of the detector/descriptor/matcher/selector combination if there is one
+    bool bFusedDetectDescribe = true; // detector and descriptor of the same type (ORB, BRISK, AKAZE, SIFT) share one detectAndCompute pass
+    int cornerBudget = 0;         // SHITOMASI, HARRIS: max. no. of corners per image (per tile in tiled detection), 0 = no limit
+    bool bNativeCorners = true;   // SHITOMASI, HARRIS: fused native response and candidate kernels instead of the opencv functions
+    bool bTiledDetection = false; // run the detector on overlapping tiles in parallel
+    int tileRows = 2;             // no. of tile rows in tiled detection
+    int tileCols = 4;             // no. of tile columns in tiled detection
+    int tileOverlap = 32;         // overlap of neighbouring tiles in pixels
+    int tileBudget = 0;           // max. no. of keypoints per tile, 0 = no limit
+    std::string descCompression = "NONE"; // float descriptors (SIFT) are kept as NONE (float), U8 (8 bit) or FP16 (half float)
+    std::string descPcaFile = ""; // PCA projection applied before the quantization, empty = none
+    int descPcaDims = 64;         // no. of PCA components learned with bLearnDescPca
+    bool bLearnDescPca = false;   // learn the PCA of the descriptors of the source, write it to descPcaFile and exit
+    double matchRatio = 0.8;     // SEL_KNN: max. ratio between best and second best descriptor distance
+    bool bCrossCheck = false;    // only keep matches which are mutual best matches
+    bool bFlannIncremental = false; // MAT_FLANN: build the index once per frame and reuse it on the next frame
+    std::string flannBinaryIndex = "LSH"; // MAT_FLANN index of binary descriptors, LSH or HIERARCHICAL
+    int flannTrees = 4;          // MAT_FLANN: no. of randomized kd-trees (float) or clustering trees (HIERARCHICAL)
+    int flannChecks = 32;        // MAT_FLANN: max. no. of leaves visited per query, more is slower and more exact
+    int flannLshTables = 12;     // MAT_FLANN LSH: no. of hash tables
+    int flannLshKeySize = 20;    // MAT_FLANN LSH: no. of hash bits per table
+    int flannLshProbes = 2;      // MAT_FLANN LSH: no. of neighbouring buckets probed, 0 = exact bucket only
+    bool bGatedMatching = false; // only match keypoints which are close to the predicted position
+    float gateRadius = 30.0f;    // search radius in pixels around the predicted position
+    bool bGateMotionPrior = true; // predict positions with the median flow of the last frame, otherwise assume no motion
+    bool bGeomVerify = false;    // verify the matches of a frame pair against a robustly fitted fundamental matrix or homography
+    std::string geomModel = "FUNDAMENTAL"; // FUNDAMENTAL (any static scene) or HOMOGRAPHY (planar scene, pure rotation)
+    float geomThreshold = 1.0f;  // max. Sampson distance (FUNDAMENTAL) or reprojection error (HOMOGRAPHY) of an inlier in pixels
+    double geomConfidence = 0.999; // stop sampling once a model with more inliers is this unlikely to be missed
+    int geomMaxIters = 2000;     // max. no. of samples per frame pair
+    int geomMinMatches = 15;     // frame pairs with fewer matches are not verified
+    bool bGeomRemoveOutliers = true; // drop the outliers from the matches, otherwise only the inlier mask is set
+    bool bKltTracking = false; // track keypoints with optical flow between keyframes instead of detecting them
+    int kltKeyframeInterval = 5; // every n-th frame is a keyframe which is detected, described and matched
+    int kltMinTracks = 100;    // a keyframe is also taken when fewer keypoints are tracked
+    int kltWinSize = 21;       // search window of the optical flow in pixels
+    int kltPyrLevels = 3;      // no. of pyramid levels above the image
+    bool bTrackHistory = true; // link the matches of consecutive frames into tracks with persistent ids
+    int trackMaxLost = 2;      // no. of frames a track is kept after it was last matched
+    int trackMaxHistory = 30;  // no. of observations kept per track
+    std::string sourceType = "IMAGES"; // IMAGES, VIDEO or RAW
+    std::string sourcePath = "../images/KITTI/2011_09_26/image_00/data/%010d.png"; // printf pattern of the image files for IMAGES
+    int firstFrame = 0;        // index of the first frame (file number for IMAGES)
+    int numFrames = 10;        // no. of frames to process, 0 = all frames of the source
+    int decodeThreads = 2;     // IMAGES: no. of threads decoding images ahead of the tracker
+    int prefetchFrames = 4;    // max. no. of decoded frames waiting for the tracker
+    std::string rawExportFile = ""; // convert the source into a raw sequence file and exit, empty = no export
+    std::string logLevel = "INFO"; // TRACE, DEBUG, INFO, WARN, ERROR or OFF
+    std::string traceFile = "";    // write timers and counters as chrome trace json to this file, empty = no tracing
+    bool pipelineMode = false; // run image loading, detection/description and matching as concurrent stages
+    int numDetectWorkers = 2;  // no. of detection/description threads in pipeline mode
+    int queueCapacity = 4;     // max. no. of frames waiting between two pipeline stages
+    bool batchMode = false;    // process the whole sequence at once for throughput: parallel detection, then parallel matching
+    int batchWorkers = 0;      // no. of threads in batch mode, 0 uses all cores
+    std::vector<std::string> streamSources; // MultiStreamTracking: sourcePath of every stream, empty = the one sourcePath
+    int streamWorkers = 0;     // MultiStreamTracking: no. of threads shared by the streams, 0 uses all cores
+    bool bPinThreads = false;  // MultiStreamTracking: pin every worker thread to its own core (linux only)
+    int dataBufferSize = 2;    // no. of frames held in the ring buffer of the feature tracker
+    int benchThreads = 0;      // TestDifferentSettings: no. of combinations run in parallel, 0 uses all cores
+    int benchRuns = 5;         // TestDifferentSettings: no. of measured runs over the dataset per combination
+    int benchWarmupRuns = 1;   // TestDifferentSettings: no. of runs per combination which are not measured
+    std::string benchOutput = "/tmp/results"; // TestDifferentSettings: prefix of the csv result files
 };
 
 
@@ -8,6 +8,8 @@
 #include <vector>
 #include <cmath>
 #include <limits>
+#include <functional>
+#include <memory>
 
 #include <opencv2/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -22,64 +24,138 @@ class KPDetector
 {
 public:
     virtual std::vector<cv::KeyPoint> DetectKeypoints(const cv::Mat&, bool bVis = false) = 0;
+
+    // Detect and describe in one pass, so the scale space built for detection is used for the
+    // descriptors as well. Only for detectors which are also a descriptor (ORB, BRISK, AKAZE,
+    // SIFT), the descriptors equal those of the descriptor of the same name. Returns false if
+    // the detector can't describe its keypoints.
+    virtual bool DetectAndDescribe(const cv::Mat&, std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors) { return false; }
+
+    // Scale the detection threshold so about factor times as many keypoints are found, factor > 1
+    // asks for more keypoints. Returns false if the detector has no threshold to adjust.
+    virtual bool AdjustSensitivity(double factor) { return false; }
     virtual ~KPDetector() {}
 };
 
-class DetectorShiTomasi : public KPDetector
+// cornerBudget: max. no. of corners per image, 0 = no limit. bNativeCorners: response and
+// candidates come from the fused kernels in CornerKernels.h instead of the opencv functions
+class DetectorShiTomasi final : public KPDetector
 {
 public:
+    explicit DetectorShiTomasi(int cornerBudget = 0, bool bNativeCorners = true);
     std::vector<cv::KeyPoint> DetectKeypoints(const cv::Mat&, bool bVis = false);
     ~DetectorShiTomasi() {}
+private:
+    std::vector<cv::Point2f> DetectCornersNative(const cv::Mat& img, int maxCorners) const;
+    int blockSize_ = 4;           //  size of an average block for computing a derivative covariation matrix over each pixel neighborhood
+    double minDistance_ = 4.0;    // min. distance between two corners, (1 - max. overlap) * blockSize
+    double qualityLevel_ = 0.01;  // minimal accepted quality of image corners
+    double k_ = 0.04;
+    int cornerBudget_;
+    bool bNativeCorners_;
 };
 
-class DetectorHarris : public KPDetector
+// cornerBudget and bNativeCorners as for DetectorShiTomasi
+class DetectorHarris final : public KPDetector
 {
 public:
+    explicit DetectorHarris(int cornerBudget = 0, bool bNativeCorners = true);
     std::vector<cv::KeyPoint> DetectKeypoints(const cv::Mat&, bool bVis = false);
+    bool AdjustSensitivity(double factor);
     ~DetectorHarris() {}
 private:
     std::vector<cv::KeyPoint> GetKeypoints(const cv::Mat dst_norm) const;
+    std::vector<cv::KeyPoint> DetectKeypointsNative(const cv::Mat& img) const;
+    std::vector<cv::KeyPoint> SuppressOverlaps(const std::vector<cv::KeyPoint>& sorted, cv::Size imgSize) const;
     // compute detector parameters based on image size
     int blockSize_ = 2;       //  size of an average block for computing a derivative covariation matrix over each pixel neighborhood
     int apertureSize_ = 3;
     double k_ = 0.04;
     int minResponse_ = 100; // minimum value for a corner in the 8bit scaled response matrix
     double maxOverlap_ = 0.0; // max. permissible overlap between two features in %, used during non-maxima suppression
+    int cornerBudget_;
+    bool bNativeCorners_;
 };
 
-class DetectorFast : public KPDetector
+class DetectorFast final : public KPDetector
 {
 public:
+    DetectorFast();
     std::vector<cv::KeyPoint> DetectKeypoints(const cv::Mat&, bool bVis = false);
+    bool AdjustSensitivity(double factor);
     ~DetectorFast() {}
+private:
+    cv::Ptr<cv::FastFeatureDetector> detector_; // created once and reused for every frame
 };
 
-class DetectorBrisk : public KPDetector
+class DetectorBrisk final : public KPDetector
 {
 public:
+    DetectorBrisk();
     std::vector<cv::KeyPoint> DetectKeypoints(const cv::Mat&, bool bVis = false);
+    bool DetectAndDescribe(const cv::Mat&, std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors);
+    bool AdjustSensitivity(double factor);
     ~DetectorBrisk() {}
+private:
+    cv::Ptr<cv::BRISK> detector_; // created once and reused for every frame
+    int threshold_ = 30;          // FAST/AGAST score threshold, the opencv default
 };
 
-class DetectorOrb : public KPDetector
+class DetectorOrb final : public KPDetector
 {
 public:
+    DetectorOrb();
     std::vector<cv::KeyPoint> DetectKeypoints(const cv::Mat&, bool bVis = false);
+    bool DetectAndDescribe(const cv::Mat&, std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors);
+    bool AdjustSensitivity(double factor);
     ~DetectorOrb() {}
+private:
+    cv::Ptr<cv::ORB> detector_; // created once and reused for every frame
 };
 
-class DetectorAkaze : public KPDetector
+class DetectorAkaze final : public KPDetector
 {
 public:
+    DetectorAkaze();
     std::vector<cv::KeyPoint> DetectKeypoints(const cv::Mat&, bool bVis = false);
+    bool DetectAndDescribe(const cv::Mat&, std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors);
+    bool AdjustSensitivity(double factor);
     ~DetectorAkaze() {}
+private:
+    cv::Ptr<cv::AKAZE> detector_; // created once and reused for every frame
 };
 
-class DetectorSift : public KPDetector
+class DetectorSift final : public KPDetector
 {
 public:
+    DetectorSift();
     std::vector<cv::KeyPoint> DetectKeypoints(const cv::Mat&, bool bVis = false);
+    bool DetectAndDescribe(const cv::Mat&, std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors);
+    bool AdjustSensitivity(double factor);
     ~DetectorSift() {}
+private:
+    cv::Ptr<cv::xfeatures2d::SIFT> detector_; // created once and reused for every frame
+    double contrastThreshold_ = 0.04;         // the opencv default
+};
+
+// Splits the image into overlapping tiles and runs a detector on each tile in parallel.
+// Every tile owns the keypoints inside its core (the tile without the overlap), so keypoints
+// found twice in an overlap zone are kept only once. The overlap gives detectors the border
+// they need near the core edges. Each tile keeps at most tileBudget keypoints (0 = no limit).
+class DetectorTiled : public KPDetector
+{
+public:
+    DetectorTiled(std::function<std::unique_ptr<KPDetector>()> createDetector,
+                  int tileRows, int tileCols, int tileOverlap, int tileBudget);
+    std::vector<cv::KeyPoint> DetectKeypoints(const cv::Mat&, bool bVis = false);
+    bool AdjustSensitivity(double factor);
+    ~DetectorTiled() {}
+private:
+    std::vector<std::unique_ptr<KPDetector>> detectors_; // one detector per tile, so tiles can run concurrently
+    int tileRows_;
+    int tileCols_;
+    int tileOverlap_;
+    int tileBudget_;
 };
 
 std::vector<cv::KeyPoint> detKeypointsShiTomasi(const cv::Mat &img, bool bVis=false);
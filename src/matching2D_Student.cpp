@@ -1,8 +1,18 @@
+#include <algorithm>
+#include <cmath>
 #include <numeric>
 #include "matching2D.hpp"
+#include "CornerKernels.h"
+#include "Instrumentation.h"
 
 using namespace std;
 
+// the native corner paths start with this many times the corner budget as candidates. The
+// distance and overlap checks after the selection reject some of them, the response is scanned
+// again with kCandidateGrowth times the capacity until the budget is reached
+const size_t kCandidateSlack = 2;
+const size_t kCandidateGrowth = 4;
+
 
 // Use one of several types of state-of-art descriptors to uniquely identify keypoints
 cv::Mat descKeypoints(vector<cv::KeyPoint> &keypoints,
@@ -12,118 +22,280 @@ cv::Mat descKeypoints(vector<cv::KeyPoint> &keypoints,
 {
     cv::Mat descriptors;
     // perform feature description
-    double t = (double)cv::getTickCount();
+    ScopedTimer timer("compute descriptors");
     _descriptor->compute(img, keypoints, descriptors);
-    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
-    cout << params.descriptorType << " descriptor extraction in " << 1000 * t / 1.0 << " ms" << endl;
+    FT_LOG_DEBUG(params.descriptorType << " descriptor extraction in " << 1000 * timer.Elapsed() << " ms");
     return descriptors;
 }
 
+// detectAndCompute of an opencv feature, used by the detectors which describe their own keypoints
+void DetectAndCompute(cv::Feature2D& feature, const char* name, const cv::Mat& img,
+                      vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors)
+{
+    ScopedTimer timer("detect and describe");
+    feature.detectAndCompute(img, cv::noArray(), keypoints, descriptors);
+    FT_LOG_DEBUG(name << " detection and description with n=" << keypoints.size() << " keypoints in " << 1000 * timer.Elapsed() << " ms");
+}
+
+// integer threshold for about factor times as many keypoints, at least one step from the old one
+int ScaleThreshold(int threshold, double factor, int minThreshold, int maxThreshold)
+{
+    int scaled = (int)lround(threshold / factor);
+    if (scaled == threshold)
+        scaled += factor > 1.0 ? -1 : 1;
+    return min(maxThreshold, max(minThreshold, scaled));
+}
+
+DetectorHarris::DetectorHarris(int cornerBudget, bool bNativeCorners)
+    : cornerBudget_(cornerBudget), bNativeCorners_(bNativeCorners)
+{
+}
+
+// structuring element of the pixel offsets at which two keypoints of the size overlap, i.e. are
+// less than size apart. MORPH_ELLIPSE rounds the row widths and misses offsets like (5, 3)
+static cv::Mat OverlapDisk(float kptSize)
+{
+    const int radius = (int)ceil(kptSize) - 1;
+    cv::Mat disk(2 * radius + 1, 2 * radius + 1, CV_8UC1);
+    for (int dy = -radius; dy <= radius; dy++)
+        for (int dx = -radius; dx <= radius; dx++)
+            disk.at<uchar>(dy + radius, dx + radius) = dx * dx + dy * dy < kptSize * kptSize;
+    return disk;
+}
+
 // perform non-maximum supporesion to get only the good keypoints
 std::vector<cv::KeyPoint> DetectorHarris::GetKeypoints(const cv::Mat dst_norm) const
 {
+    const float kptSize = 2 * apertureSize_;
+
+    // candidates are pixels above the threshold which are the maximum of the disk of keypoints
+    // they overlap. The max filter and the compares run vectorized over whole rows inside opencv
+    cv::Mat localMax, isMax, aboveThresh;
+    cv::dilate(dst_norm, localMax, OverlapDisk(kptSize));
+    cv::compare(dst_norm, localMax, isMax, cv::CMP_GE);
+    cv::compare(dst_norm, minResponse_ + 1, aboveThresh, cv::CMP_GE); // same as (int)response > minResponse_
+    cv::bitwise_and(isMax, aboveThresh, isMax);
+
+    std::vector<cv::Point> candidates;
+    cv::findNonZero(isMax, candidates);
+
+    // strongest candidates first, so a keypoint is only rejected in favour of a stronger one
+    std::vector<cv::KeyPoint> sorted;
+    sorted.reserve(candidates.size());
+    for (const auto& c : candidates)
+        sorted.emplace_back(cv::Point2f(c.x, c.y), kptSize, -1, (int)dst_norm.at<float>(c.y, c.x));
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const cv::KeyPoint& a, const cv::KeyPoint& b) { return a.response > b.response; });
+    return SuppressOverlaps(sorted, dst_norm.size());
+}
+
+// keypoints of the sorted candidates which don't overlap a stronger one, at most cornerBudget_
+std::vector<cv::KeyPoint> DetectorHarris::SuppressOverlaps(const std::vector<cv::KeyPoint>& sorted, cv::Size imgSize) const
+{
+    const float kptSize = 2 * apertureSize_;
+
+    // window maxima can still overlap (plateaus, window corners), resolve them with a bucketed
+    // spatial hash which only compares against keypoints in the neighbouring cells
+    const int cellsX = imgSize.width / (int)kptSize + 1;
+    const int cellsY = imgSize.height / (int)kptSize + 1;
+    std::vector<int> cellHead(cellsX * cellsY, -1); // last keypoint added to each cell
+    std::vector<int> next;                          // previous keypoint in the same cell
+
     std::vector<cv::KeyPoint> keypoints;
-    for (size_t j = 0; j < dst_norm.rows; j++)
+    for (const auto& newKeyPoint : sorted)
     {
-        for (size_t i = 0; i < dst_norm.cols; i++)
+        if (cornerBudget_ > 0 && (int)keypoints.size() >= cornerBudget_)
+            break;
+        const int cx = (int)newKeyPoint.pt.x / (int)kptSize;
+        const int cy = (int)newKeyPoint.pt.y / (int)kptSize;
+        bool bOverlap = false;
+        for (int y = std::max(0, cy - 1); y <= std::min(cellsY - 1, cy + 1) && !bOverlap; y++)
         {
-            int response = (int)dst_norm.at<float>(j, i);
-            if (response > minResponse_)
-            { // only store points above a threshold
-
-                cv::KeyPoint newKeyPoint;
-                newKeyPoint.pt = cv::Point2f(i, j);
-                newKeyPoint.size = 2 * apertureSize_;
-                newKeyPoint.response = response;
-
-                // perform non-maximum suppression (NMS) in local neighbourhood around new key point
-                bool bOverlap = false;
-                for (auto it = keypoints.begin(); it != keypoints.end(); ++it)
+            for (int x = std::max(0, cx - 1); x <= std::min(cellsX - 1, cx + 1) && !bOverlap; x++)
+            {
+                for (int k = cellHead[y * cellsX + x]; k >= 0; k = next[k])
                 {
-                    double kptOverlap = cv::KeyPoint::overlap(newKeyPoint, *it);
-                    if (kptOverlap > maxOverlap_)
+                    if (cv::KeyPoint::overlap(newKeyPoint, keypoints[k]) > maxOverlap_)
                     {
                         bOverlap = true;
-                        if (newKeyPoint.response > (*it).response)
-                        {                      // if overlap is >t AND response is higher for new kpt
-                            *it = newKeyPoint; // replace old key point with new one
-                            break;             // quit loop over keypoints
-                        }
+                        break;
                     }
                 }
-                if (!bOverlap)
-                {                                     // only add new key point if no overlap has been found in previous NMS
-                    keypoints.push_back(newKeyPoint); // store new keypoint in dynamic list
-                }
             }
-        } // eof loop over cols
-    }     // eof loop over rows
+        }
+        if (!bOverlap)
+        {
+            next.push_back(cellHead[cy * cellsX + cx]);
+            cellHead[cy * cellsX + cx] = keypoints.size();
+            keypoints.push_back(newKeyPoint);
+        }
+    }
     return keypoints;
 }
 
+// Same keypoints as cornerHarris, normalize and GetKeypoints, from one pass over the image and
+// one over the response. The min-max normalization to [0, 255] is applied to the threshold and
+// to the responses of the candidates only.
+std::vector<cv::KeyPoint> DetectorHarris::DetectKeypointsNative(const cv::Mat& img) const
+{
+    cv::Mat response;
+    float minVal, maxVal;
+    CornerResponseMap(img, blockSize_, CornerResponseType::Harris, k_, response, minVal, maxVal);
+    if (maxVal <= minVal)
+        return std::vector<cv::KeyPoint>();
+
+    const float scale = 255.f / (maxVal - minVal);
+    const float kptSize = 2 * apertureSize_;
+    const float minResponse = minVal + (minResponse_ + 1) / scale;
+    size_t capacity = cornerBudget_ > 0 ? kCandidateSlack * cornerBudget_ : 0;
+    while (true)
+    {
+        // the maxima of the overlap disk are among the 3x3 maxima, the square window of the
+        // separable filter would also remove maxima which don't overlap a stronger one
+        vector<Corner> candidates = SelectCorners(response, minResponse, 1, 0, capacity);
+        const bool bTruncated = capacity > 0 && candidates.size() >= capacity;
+        KeepDiskMaxima(response, kptSize, candidates);
+
+        std::vector<cv::KeyPoint> sorted;
+        sorted.reserve(candidates.size());
+        for (const auto& c : candidates)
+            sorted.emplace_back(cv::Point2f(c.x, c.y), kptSize, -1, (int)((c.response - minVal) * scale));
+        // order of the opencv path: 8 bit response, then raster order
+        std::sort(sorted.begin(), sorted.end(), [](const cv::KeyPoint& a, const cv::KeyPoint& b) {
+            if (a.response != b.response)
+                return a.response > b.response;
+            return a.pt.y != b.pt.y ? a.pt.y < b.pt.y : a.pt.x < b.pt.x;
+        });
+        std::vector<cv::KeyPoint> keypoints = SuppressOverlaps(sorted, img.size());
+        if (!bTruncated || (int)keypoints.size() >= cornerBudget_)
+            return keypoints;
+        capacity *= kCandidateGrowth;
+    }
+}
+
+DetectorOrb::DetectorOrb() : detector_(cv::ORB::create())
+{
+}
+
 std::vector<cv::KeyPoint> DetectorOrb::DetectKeypoints(const cv::Mat& img, bool bVis)
 {
     vector<cv::KeyPoint> keypoints;
 
-    double t = (double)cv::getTickCount();
-    cv::Ptr<cv::ORB> orb = cv::ORB::create();
-    orb->detect(img, keypoints);
-
-    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    ScopedTimer timer("detect ORB");
+    detector_->detect(img, keypoints);
 
-    cout << "ORB detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
+    FT_LOG_DEBUG("ORB detection with n=" << keypoints.size() << " keypoints in " << 1000 * timer.Elapsed() << " ms");
 
     return keypoints;
 }
 
+bool DetectorOrb::DetectAndDescribe(const cv::Mat& img, vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors)
+{
+    DetectAndCompute(*detector_, "ORB", img, keypoints, descriptors);
+    return true;
+}
+
+// ORB keeps the best nfeatures keypoints
+bool DetectorOrb::AdjustSensitivity(double factor)
+{
+    detector_->setMaxFeatures(min(100000, max(50, (int)lround(detector_->getMaxFeatures() * factor))));
+    FT_LOG_DEBUG("ORB nfeatures " << detector_->getMaxFeatures());
+    return true;
+}
+
+DetectorAkaze::DetectorAkaze() : detector_(cv::AKAZE::create())
+{
+}
+
 std::vector<cv::KeyPoint> DetectorAkaze::DetectKeypoints(const cv::Mat& img, bool bVis)
 {
     vector<cv::KeyPoint> keypoints;
 
-    double t = (double)cv::getTickCount();
-    cv::Ptr<cv::AKAZE> akaze = cv::AKAZE::create();
-    akaze->detect(img, keypoints);
-
-    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    ScopedTimer timer("detect AKAZE");
+    detector_->detect(img, keypoints);
 
-    cout << "AKAZE detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
+    FT_LOG_DEBUG("AKAZE detection with n=" << keypoints.size() << " keypoints in " << 1000 * timer.Elapsed() << " ms");
 
     return keypoints;
 }
 
+bool DetectorAkaze::DetectAndDescribe(const cv::Mat& img, vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors)
+{
+    DetectAndCompute(*detector_, "AKAZE", img, keypoints, descriptors);
+    return true;
+}
+
+bool DetectorAkaze::AdjustSensitivity(double factor)
+{
+    detector_->setThreshold(min(0.1, max(1e-5, detector_->getThreshold() / factor)));
+    FT_LOG_DEBUG("AKAZE threshold " << detector_->getThreshold());
+    return true;
+}
+
+DetectorSift::DetectorSift() : detector_(cv::xfeatures2d::SIFT::create())
+{
+}
+
 std::vector<cv::KeyPoint> DetectorSift::DetectKeypoints(const cv::Mat& img, bool bVis)
 {
     vector<cv::KeyPoint> keypoints;
 
-    double t = (double)cv::getTickCount();
-    cv::Ptr<cv::xfeatures2d::SIFT> sift = cv::xfeatures2d::SIFT::create();
-    sift->detect(img, keypoints);
+    ScopedTimer timer("detect SIFT");
+    detector_->detect(img, keypoints);
 
-    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
-
-    cout << "SIFT detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
+    FT_LOG_DEBUG("SIFT detection with n=" << keypoints.size() << " keypoints in " << 1000 * timer.Elapsed() << " ms");
 
     return keypoints;
 }
 
+bool DetectorSift::DetectAndDescribe(const cv::Mat& img, vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors)
+{
+    DetectAndCompute(*detector_, "SIFT", img, keypoints, descriptors);
+    return true;
+}
+
+// the opencv 3 SIFT has no setters, it is created again with the new contrast threshold
+bool DetectorSift::AdjustSensitivity(double factor)
+{
+    contrastThreshold_ = min(0.2, max(0.005, contrastThreshold_ / factor));
+    detector_ = cv::xfeatures2d::SIFT::create(0, 3, contrastThreshold_);
+    FT_LOG_DEBUG("SIFT contrast threshold " << contrastThreshold_);
+    return true;
+}
+
+DetectorBrisk::DetectorBrisk() : detector_(cv::BRISK::create())
+{
+}
+
 std::vector<cv::KeyPoint> DetectorBrisk::DetectKeypoints(const cv::Mat& img, bool bVis)
 {
     vector<cv::KeyPoint> keypoints;
 
-    double t = (double)cv::getTickCount();
-    cv::Ptr<cv::BRISK> brisk = cv::BRISK::create();
-    brisk->detect(img, keypoints);
-
-    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    ScopedTimer timer("detect BRISK");
+    detector_->detect(img, keypoints);
 
-    cout << "BRISK detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
+    FT_LOG_DEBUG("BRISK detection with n=" << keypoints.size() << " keypoints in " << 1000 * timer.Elapsed() << " ms");
 
     return keypoints;
 }
 
-std::vector<cv::KeyPoint> DetectorFast::DetectKeypoints(const cv::Mat& img, bool bVis)
+bool DetectorBrisk::DetectAndDescribe(const cv::Mat& img, vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors)
+{
+    DetectAndCompute(*detector_, "BRISK", img, keypoints, descriptors);
+    return true;
+}
+
+// the opencv 3 BRISK has no setters, it is created again with the new threshold
+bool DetectorBrisk::AdjustSensitivity(double factor)
+{
+    threshold_ = ScaleThreshold(threshold_, factor, 5, 255);
+    detector_ = cv::BRISK::create(threshold_);
+    FT_LOG_DEBUG("BRISK threshold " << threshold_);
+    return true;
+}
+
+DetectorFast::DetectorFast()
 {
-    vector<cv::KeyPoint> keypoints;
     int threshold = 10;
     bool useNonMaxSuppression = true;
 
@@ -131,49 +303,202 @@ std::vector<cv::KeyPoint> DetectorFast::DetectKeypoints(const cv::Mat& img, bool
     //int type = FastFeatureDetector::TYPE_7_12;
     //int type = FastFeatureDetector::TYPE_5_8;
 
-    double t = (double)cv::getTickCount();
-    cv::FAST(img, keypoints, threshold, useNonMaxSuppression, type);
-    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
+    detector_ = cv::FastFeatureDetector::create(threshold, useNonMaxSuppression, type);
+}
+
+bool DetectorFast::AdjustSensitivity(double factor)
+{
+    detector_->setThreshold(ScaleThreshold(detector_->getThreshold(), factor, 1, 255));
+    FT_LOG_DEBUG("FAST threshold " << detector_->getThreshold());
+    return true;
+}
+
+std::vector<cv::KeyPoint> DetectorFast::DetectKeypoints(const cv::Mat& img, bool bVis)
+{
+    vector<cv::KeyPoint> keypoints;
 
-    cout << "FAST detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
+    ScopedTimer timer("detect FAST");
+    detector_->detect(img, keypoints);
+
+    FT_LOG_DEBUG("FAST detection with n=" << keypoints.size() << " keypoints in " << 1000 * timer.Elapsed() << " ms");
 
     return keypoints;
 }
 
+bool DetectorHarris::AdjustSensitivity(double factor)
+{
+    minResponse_ = ScaleThreshold(minResponse_, factor, 1, 254);
+    FT_LOG_DEBUG("Harris min. response " << minResponse_);
+    return true;
+}
+
 std::vector<cv::KeyPoint> DetectorHarris::DetectKeypoints(const cv::Mat& img, bool bVis)
 {
     // Apply corner detection
-    double t = (double)cv::getTickCount();
-    //vector<cv::Point2f> corners;
-    cv::Mat dst_norm;
-    cv::Mat dst = cv::Mat::zeros( img.size(), CV_32FC1 );
-    cv::cornerHarris(img, dst, blockSize_, apertureSize_, k_);
-    cv::normalize(dst, dst_norm, 0, 255, cv::NORM_MINMAX, CV_32FC1, cv::Mat());
+    ScopedTimer timer("detect HARRIS");
+    vector<cv::KeyPoint> keypoints;
+    if (bNativeCorners_ && img.type() == CV_8UC1 && apertureSize_ == 3) // the kernels use a 3x3 Sobel
+    {
+        keypoints = DetectKeypointsNative(img);
+    }
+    else
+    {
+        cv::Mat dst_norm;
+        cv::Mat dst = cv::Mat::zeros( img.size(), CV_32FC1 );
+        cv::cornerHarris(img, dst, blockSize_, apertureSize_, k_);
+        cv::normalize(dst, dst_norm, 0, 255, cv::NORM_MINMAX, CV_32FC1, cv::Mat());
+        keypoints = GetKeypoints(dst_norm);
+    }
+    FT_LOG_DEBUG("Harris detection with n=" << keypoints.size() << " keypoints in " << 1000 * timer.Elapsed() << " ms");
 
-    vector<cv::KeyPoint> keypoints = GetKeypoints(dst_norm);
-    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
-    cout << "Harris detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
+    return keypoints;
+}
 
+DetectorTiled::DetectorTiled(std::function<std::unique_ptr<KPDetector>()> createDetector,
+                             int tileRows, int tileCols, int tileOverlap, int tileBudget)
+    : tileRows_(max(1, tileRows)), tileCols_(max(1, tileCols)), tileOverlap_(max(0, tileOverlap)), tileBudget_(tileBudget)
+{
+    for (int i = 0; i < tileRows_ * tileCols_; i++)
+        detectors_.push_back(createDetector());
+}
+
+std::vector<cv::KeyPoint> DetectorTiled::DetectKeypoints(const cv::Mat& img, bool bVis)
+{
+    ScopedTimer timer("detect tiled");
+    const cv::Rect imageRect(0, 0, img.cols, img.rows);
+    const int numTiles = tileRows_ * tileCols_;
+    vector<vector<cv::KeyPoint>> tileKeypoints(numTiles);
+
+    cv::parallel_for_(cv::Range(0, numTiles), [&](const cv::Range& range) {
+        for (int tile = range.start; tile < range.end; tile++)
+        {
+            const int row = tile / tileCols_, col = tile % tileCols_;
+            const int x0 = col * img.cols / tileCols_, x1 = (col + 1) * img.cols / tileCols_;
+            const int y0 = row * img.rows / tileRows_, y1 = (row + 1) * img.rows / tileRows_;
+            const cv::Rect core(x0, y0, x1 - x0, y1 - y0);
+            const cv::Rect expanded = cv::Rect(x0 - tileOverlap_, y0 - tileOverlap_,
+                                               core.width + 2 * tileOverlap_, core.height + 2 * tileOverlap_) & imageRect;
+
+            vector<cv::KeyPoint> keypoints = detectors_[tile]->DetectKeypoints(img(expanded), false);
+
+            // shift to image coordinates and keep only the keypoints owned by this tile
+            vector<cv::KeyPoint>& owned = tileKeypoints[tile];
+            owned.reserve(keypoints.size());
+            for (auto& kpt : keypoints)
+            {
+                kpt.pt.x += expanded.x;
+                kpt.pt.y += expanded.y;
+                if (core.contains(kpt.pt))
+                    owned.push_back(kpt);
+            }
+
+            if (tileBudget_ > 0 && (int)owned.size() > tileBudget_)
+            {
+                bool bHasResponse = std::any_of(owned.begin(), owned.end(), [](const cv::KeyPoint& k) { return k.response != 0; });
+                if (bHasResponse)
+                    cv::KeyPointsFilter::retainBest(owned, tileBudget_);
+                else // no response info (e.g. Shi-Tomasi), keypoints are already sorted by quality
+                    owned.resize(tileBudget_);
+            }
+        }
+    });
+
+    vector<cv::KeyPoint> keypoints;
+    for (const auto& owned : tileKeypoints)
+        keypoints.insert(keypoints.end(), owned.begin(), owned.end());
+
+    FT_LOG_DEBUG("Tiled detection (" << tileRows_ << "x" << tileCols_ << ") with n=" << keypoints.size() << " keypoints in " << 1000 * timer.Elapsed() << " ms");
     return keypoints;
 }
 
+bool DetectorTiled::AdjustSensitivity(double factor)
+{
+    bool bAdjusted = true;
+    for (auto& detector : detectors_)
+        bAdjusted = detector->AdjustSensitivity(factor) && bAdjusted;
+    return bAdjusted;
+}
+
+DetectorShiTomasi::DetectorShiTomasi(int cornerBudget, bool bNativeCorners)
+    : cornerBudget_(cornerBudget), bNativeCorners_(bNativeCorners)
+{
+}
+
+// goodFeaturesToTrack with the fused kernels: corners above qualityLevel times the best response
+// which are the maximum of their 3x3 window, strongest first and at least minDistance apart
+std::vector<cv::Point2f> DetectorShiTomasi::DetectCornersNative(const cv::Mat& img, int maxCorners) const
+{
+    cv::Mat response;
+    float minVal, maxVal;
+    CornerResponseMap(img, blockSize_, CornerResponseType::MinEigenVal, k_, response, minVal, maxVal);
+    vector<cv::Point2f> corners;
+    if (maxVal <= 0.f)
+        return corners;
+
+    // goodFeaturesToTrack keeps responses above the threshold and skips the outer pixels
+    const float minResponse = nextafter((float)(maxVal * qualityLevel_), numeric_limits<float>::max());
+    size_t capacity = cornerBudget_ > 0 ? kCandidateSlack * cornerBudget_ : 0;
+    while (true)
+    {
+        const vector<Corner> candidates = SelectCorners(response, minResponse, 1, 1, capacity);
+        const bool bTruncated = capacity > 0 && candidates.size() >= capacity;
+        corners.clear();
+
+        // greedy min. distance check against the corners in the neighbouring cells of a grid
+        const int cellSize = max(1, (int)lround(minDistance_));
+        const int gridCols = (img.cols + cellSize - 1) / cellSize;
+        const int gridRows = (img.rows + cellSize - 1) / cellSize;
+        vector<vector<cv::Point2f>> grid(gridCols * gridRows);
+        const float minDistance2 = minDistance_ * minDistance_;
+        for (const auto& c : candidates)
+        {
+            if ((int)corners.size() >= maxCorners)
+                break;
+            const cv::Point2f pt((float)c.x, (float)c.y);
+            const int cx = c.x / cellSize, cy = c.y / cellSize;
+            bool bClose = false;
+            for (int y = max(0, cy - 1); y <= min(gridRows - 1, cy + 1) && !bClose; y++)
+            {
+                for (int x = max(0, cx - 1); x <= min(gridCols - 1, cx + 1) && !bClose; x++)
+                {
+                    for (const auto& other : grid[y * gridCols + x])
+                    {
+                        const cv::Point2f d = other - pt;
+                        if (d.x * d.x + d.y * d.y < minDistance2)
+                        {
+                            bClose = true;
+                            break;
+                        }
+                    }
+                }
+            }
+            if (!bClose)
+            {
+                grid[cy * gridCols + cx].push_back(pt);
+                corners.push_back(pt);
+            }
+        }
+        // candidates beyond the capacity may still pass the distance check
+        if (!bTruncated || (int)corners.size() >= maxCorners)
+            return corners;
+        capacity *= kCandidateGrowth;
+    }
+}
+
 // Detect keypoints in image using the traditional Shi-Thomasi detector
 std::vector<cv::KeyPoint> DetectorShiTomasi::DetectKeypoints(const cv::Mat& img, bool bVis)
 {
     vector<cv::KeyPoint> keypoints;
-    // compute detector parameters based on image size
-    int blockSize = 4;       //  size of an average block for computing a derivative covariation matrix over each pixel neighborhood
-    double maxOverlap = 0.0; // max. permissible overlap between two features in %
-    double minDistance = (1.0 - maxOverlap) * blockSize;
-    int maxCorners = img.rows * img.cols / max(1.0, minDistance); // max. num. of keypoints
-
-    double qualityLevel = 0.01; // minimal accepted quality of image corners
-    double k = 0.04;
+    // without a budget every corner at least minDistance apart may be kept
+    int maxCorners = cornerBudget_ > 0 ? cornerBudget_ : img.rows * img.cols / max(1.0, minDistance_);
 
     // Apply corner detection
-    double t = (double)cv::getTickCount();
+    ScopedTimer timer("detect SHITOMASI");
     vector<cv::Point2f> corners;
-    cv::goodFeaturesToTrack(img, corners, maxCorners, qualityLevel, minDistance, cv::Mat(), blockSize, false, k);
+    if (bNativeCorners_ && img.type() == CV_8UC1)
+        corners = DetectCornersNative(img, maxCorners);
+    else
+        cv::goodFeaturesToTrack(img, corners, maxCorners, qualityLevel_, minDistance_, cv::Mat(), blockSize_, false, k_);
 
     // add corners to result vector
     for (auto it = corners.begin(); it != corners.end(); ++it)
@@ -181,11 +506,10 @@ std::vector<cv::KeyPoint> DetectorShiTomasi::DetectKeypoints(const cv::Mat& img,
 
         cv::KeyPoint newKeyPoint;
         newKeyPoint.pt = cv::Point2f((*it).x, (*it).y);
-        newKeyPoint.size = blockSize;
+        newKeyPoint.size = blockSize_;
         keypoints.push_back(newKeyPoint);
     }
-    t = ((double)cv::getTickCount() - t) / cv::getTickFrequency();
-    cout << "Shi-Tomasi detection with n=" << keypoints.size() << " keypoints in " << 1000 * t / 1.0 << " ms" << endl;
+    FT_LOG_DEBUG("Shi-Tomasi detection with n=" << keypoints.size() << " keypoints in " << 1000 * timer.Elapsed() << " ms");
 
     // visualize results
     if (bVis)
@@ -1,10 +1,16 @@
 #include "util.h"
 #include <memory> // unique_ptr
+#include <algorithm>
 #include <map>
+#include <numeric>
 #include <vector>
 #include <fstream>
+#include <sstream>
 
+#include "DescriptorCompression.h"
+#include "FeatureCache.h"
 #include "matching2D.hpp" // KPDetector
+#include "Instrumentation.h"
 
 using namespace std;
 
@@ -21,57 +27,295 @@ void LimitKeyPoints(vector<cv::KeyPoint>& keypoints, const Params& p)
         keypoints.erase(keypoints.begin() + maxKeypoints, keypoints.end());
     }
     cv::KeyPointsFilter::retainBest(keypoints, maxKeypoints);
-    cout << " NOTE: Keypoints have been limited!" << endl;
+    FT_LOG_DEBUG(" NOTE: Keypoints have been limited!");
 }
 
-void LimitKeyPointsRect(vector<cv::KeyPoint>& keypoints)
+// keep only keypoints inside one of the rectangles, in a single pass over the keypoints
+void LimitKeyPointsRect(vector<cv::KeyPoint>& keypoints, const vector<cv::Rect>& rects)
 {
-    cv::Rect vehicleRect(535, 180, 180, 150);
-    for (auto it = keypoints.begin(); it != keypoints.end(); )
+    auto outside = [&rects](const cv::KeyPoint& kpt) {
+        for (const auto& rect : rects)
+            if (rect.contains(kpt.pt))
+                return false;
+        return true;
+    };
+    keypoints.erase(std::remove_if(keypoints.begin(), keypoints.end(), outside), keypoints.end());
+}
+
+// indices of the n strongest keypoints in detection order. Keypoints without response
+// (Shi-Tomasi) are already sorted by quality, the first n are taken
+vector<int> StrongestKeyPoints(const vector<cv::KeyPoint>& keypoints, size_t n)
+{
+    vector<int> order(keypoints.size());
+    iota(order.begin(), order.end(), 0);
+    bool bHasResponse = any_of(keypoints.begin(), keypoints.end(), [](const cv::KeyPoint& k) { return k.response != 0; });
+    if (bHasResponse)
+    {
+        nth_element(order.begin(), order.begin() + n, order.end(),
+                    [&keypoints](int a, int b) { return keypoints[a].response > keypoints[b].response; });
+        order.resize(n);
+        sort(order.begin(), order.end());
+    }
+    else
+        order.resize(n);
+    return order;
+}
+
+// keep at most maxKeypoints keypoints, the strongest ones (0 = no limit)
+void RetainStrongest(vector<cv::KeyPoint>& keypoints, int maxKeypoints)
+{
+    if (maxKeypoints <= 0 || keypoints.size() <= (size_t)maxKeypoints)
+        return;
+    vector<cv::KeyPoint> kept;
+    kept.reserve(maxKeypoints);
+    for (int i : StrongestKeyPoints(keypoints, maxKeypoints))
+        kept.push_back(keypoints[i]);
+    keypoints.swap(kept);
+}
+
+// same for keypoints which are described already, their descriptor rows are kept with them
+void RetainStrongest(vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors, int maxKeypoints)
+{
+    if (maxKeypoints <= 0 || keypoints.size() <= (size_t)maxKeypoints)
+        return;
+    vector<int> rows = StrongestKeyPoints(keypoints, maxKeypoints);
+    vector<cv::KeyPoint> kept;
+    cv::Mat keptDescriptors(rows.size(), descriptors.cols, descriptors.type());
+    kept.reserve(rows.size());
+    for (size_t r = 0; r < rows.size(); r++)
+    {
+        kept.push_back(keypoints[rows[r]]);
+        descriptors.row(rows[r]).copyTo(keptDescriptors.row(r));
+    }
+    keypoints.swap(kept);
+    descriptors = keptDescriptors;
+}
+
+// keep only the keypoints inside one of the rectangles together with their descriptor rows
+void LimitFeaturesRect(vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors, const vector<cv::Rect>& rects)
+{
+    vector<cv::KeyPoint> keptKeypoints;
+    cv::Mat keptDescriptors;
+    keptKeypoints.reserve(keypoints.size());
+    for (size_t i = 0; i < keypoints.size(); i++)
+    {
+        for (const auto& rect : rects)
+        {
+            if (rect.contains(keypoints[i].pt))
+            {
+                keptKeypoints.push_back(keypoints[i]);
+                keptDescriptors.push_back(descriptors.row(i));
+                break;
+            }
+        }
+    }
+    keypoints.swap(keptKeypoints);
+    descriptors = keptDescriptors;
+}
+
+// Detect and describe the keypoints of img which lie in one of the rects (all if rects is null).
+// If detector and descriptor are the same algorithm the detector describes its keypoints in the
+// same pass, so the scale space is built once instead of twice. The descriptors of keypoints
+// outside the rects are computed then as well, which costs far less than the second scale space.
+// With a cache, keypoints detected before under keypointKey are described without detection.
+void DetectAndDescribeKeypoints(const cv::Mat& img,
+                                const std::unique_ptr<KPDetector>& _detector,
+                                const cv::Ptr<cv::DescriptorExtractor>& _descriptor,
+                                const Params& params,
+                                const vector<cv::Rect>* rects,
+                                vector<cv::KeyPoint>& keypoints,
+                                cv::Mat& descriptors,
+                                StageTimes& times,
+                                const FeatureCache* cache = nullptr,
+                                uint64_t keypointKey = 0)
+{
+    const bool bTryFused = params.bFusedDetectDescribe && !bLimitKpts && params.detectorType == params.descriptorType;
+    if (bTryFused)
     {
-        // delete keypoint if not inside rectangle
-        if (vehicleRect.contains(it->pt))
-            it++;
+        // the combined time is accounted to detection
+        ScopedTimer timer("detect", &times.detect);
+        if (_detector->DetectAndDescribe(img, keypoints, descriptors))
+        {
+            if (rects) LimitFeaturesRect(keypoints, descriptors, *rects);
+            RetainStrongest(keypoints, descriptors, params.maxKeypoints);
+            times.describe = 0.0;
+            return;
+        }
+    }
+
+    {
+        ScopedTimer timer("detect", &times.detect);
+        FeatureStore cachedKeypoints;
+        if (cache && cache->Load(keypointKey, cachedKeypoints))
+            keypoints = cachedKeypoints.ToKeyPoints();
         else
-            it = keypoints.erase(it);
+        {
+            keypoints = _detector->DetectKeypoints(img, false);
+
+            // optional : limit number of keypoints (helpful for debugging and learning)
+            if (bLimitKpts) LimitKeyPoints(keypoints, params);
+
+            //// TASK MP.3 -> only keep keypoints on the preceding vehicle
+            if (rects) LimitKeyPointsRect(keypoints, *rects);
+
+            // keypoint budget, the weakest keypoints are not described
+            RetainStrongest(keypoints, params.maxKeypoints);
+
+            if (cache) cache->Store(keypointKey, FeatureStore(keypoints, cv::Mat()));
+        }
+    }
+    {
+        ScopedTimer timer("describe", &times.describe);
+        descriptors = descKeypoints(keypoints, img, _descriptor, params);
+    }
+}
+
+// descCompression: the frame keeps the compact descriptors, compressing counts as description
+void CompressDescriptors(cv::Mat& descriptors, const Params& params, StageTimes* times)
+{
+    const DescriptorCompressor compressor(params);
+    if (!compressor.Enabled())
+        return;
+    double tCompress = 0.0;
+    {
+        ScopedTimer timer("compress descriptors", &tCompress);
+        compressor.Compress(descriptors);
+    }
+    if (times) times->describe += tCompress;
+}
+
+// Detect and describe only inside the focus rectangles. Every rectangle is padded so descriptors
+// of keypoints near its border still see their full neighbourhood, the padded region is processed
+// as a view into the image and keypoints are shifted back to full image coordinates afterwards.
+DataFrame DetectAndDescribeFeaturesRoi(const cv::Mat& imgGray,
+                                       const std::unique_ptr<KPDetector>& _detector,
+                                       const cv::Ptr<cv::DescriptorExtractor>& _descriptor,
+                                       const Params& params,
+                                       StageTimes* times)
+{
+    const cv::Rect imageRect(0, 0, imgGray.cols, imgGray.rows);
+    vector<cv::KeyPoint> keypoints;
+    cv::Mat descriptors;
+    double tDetect = 0.0, tDescribe = 0.0;
+    for (const auto& roi : params.focusRects)
+    {
+        cv::Rect padded(roi.x - params.roiPadding, roi.y - params.roiPadding,
+                        roi.width + 2 * params.roiPadding, roi.height + 2 * params.roiPadding);
+        padded &= imageRect;
+        if (padded.area() == 0)
+            continue;
+        cv::Mat imgRoi = imgGray(padded);
+
+        // drop the keypoints found in the padding
+        const vector<cv::Rect> core(1, cv::Rect(roi.x - padded.x, roi.y - padded.y, roi.width, roi.height));
+        vector<cv::KeyPoint> roiKeypoints;
+        cv::Mat roiDescriptors;
+        StageTimes roiTimes;
+        DetectAndDescribeKeypoints(imgRoi, _detector, _descriptor, params, &core, roiKeypoints, roiDescriptors, roiTimes);
+        tDetect += roiTimes.detect;
+        tDescribe += roiTimes.describe;
+
+        const cv::Point2f offset(padded.x, padded.y);
+        for (auto& kpt : roiKeypoints)
+            kpt.pt = kpt.pt + offset;
+        keypoints.insert(keypoints.end(), roiKeypoints.begin(), roiKeypoints.end());
+        descriptors.push_back(roiDescriptors);
     }
+    // every rect keeps its strongest maxKeypoints, which holds the strongest maxKeypoints of the
+    // frame, so the frame budget is applied once more to the merged keypoints
+    RetainStrongest(keypoints, descriptors, params.maxKeypoints);
+    if (times)
+    {
+        times->detect = tDetect;
+        times->describe = tDescribe;
+    }
+    FT_COUNTER("keypoints", keypoints.size());
+    FT_LOG_DEBUG("#2 : DETECT KEYPOINTS done (" << params.focusRects.size() << " regions)");
+    CompressDescriptors(descriptors, params, times);
+    DataFrame newFrame(imgGray, keypoints, descriptors);
+    FT_LOG_DEBUG("#3 : EXTRACT DESCRIPTORS done");
+
+    return newFrame;
 }
 
 
 DataFrame DetectAndDescribeFeatures(const cv::Mat& imgGray,
                             const std::unique_ptr<KPDetector>& _detector,
                             const cv::Ptr<cv::DescriptorExtractor>& _descriptor,
-                            const Params& params)
-{
-    cout << "#1 : LOAD IMAGE INTO BUFFER done" << endl;
-    // extract 2D keypoints from current image
-    vector<cv::KeyPoint> keypoints; // create empty feature list for current image        
-    keypoints = _detector->DetectKeypoints(imgGray, false);
-
-    // optional : limit number of keypoints (helpful for debugging and learning)
-    if (bLimitKpts) LimitKeyPoints(keypoints, params);
-
-    //// TASK MP.3 -> only keep keypoints on the preceding vehicle
-    if (params.bFocusOnVehicle) LimitKeyPointsRect(keypoints);
-    
-    cout << "#2 : DETECT KEYPOINTS done" << endl;
-    cv::Mat descriptors = descKeypoints(keypoints, imgGray, _descriptor, params);
-    // push descriptors for current frame to end of data buffer
-    DataFrame newFrame(imgGray, keypoints, descriptors);
-    cout << "#3 : EXTRACT DESCRIPTORS done" << endl;
+                            const Params& params,
+                            StageTimes* times)
+{
+    FT_LOG_DEBUG("#1 : LOAD IMAGE INTO BUFFER done");
+
+    // featureCacheDir: frames described before with the same settings are loaded from the cache.
+    // The detector threshold changes from frame to frame with a latency target, so it isn't used then
+    const FeatureCache cache(params.latencyTargetMs > 0 ? "" : params.featureCacheDir);
+    uint64_t keypointKey = 0, featureKey = 0;
+    double tLookup = 0.0; // accounted to detection
+    if (cache.Enabled())
+    {
+        DataFrame cached;
+        bool bHit;
+        {
+            ScopedTimer timer("detect", &tLookup);
+            keypointKey = KeyPointCacheKey(HashImage(imgGray), params);
+            featureKey = FeatureCacheKey(keypointKey, params);
+            bHit = cache.Load(featureKey, cached.features);
+        }
+        if (bHit)
+        {
+            cached.cameraImg = imgGray;
+            if (times)
+            {
+                times->detect = tLookup;
+                times->describe = 0.0;
+            }
+            return cached;
+        }
+    }
+
+    DataFrame newFrame;
+    if (params.bFocusOnVehicle && params.bRoiFirst)
+    {
+        newFrame = DetectAndDescribeFeaturesRoi(imgGray, _detector, _descriptor, params, times);
+        if (times) times->detect += tLookup;
+    }
+    else
+    {
+        // extract 2D keypoints from current image and describe them
+        vector<cv::KeyPoint> keypoints; // create empty feature list for current image
+        cv::Mat descriptors;
+        StageTimes frameTimes;
+        DetectAndDescribeKeypoints(imgGray, _detector, _descriptor, params,
+                                   params.bFocusOnVehicle ? &params.focusRects : nullptr,
+                                   keypoints, descriptors, frameTimes,
+                                   cache.Enabled() ? &cache : nullptr, keypointKey);
+        FT_COUNTER("keypoints", keypoints.size());
+        FT_LOG_DEBUG("#2 : DETECT KEYPOINTS done");
+        if (times)
+        {
+            times->detect = tLookup + frameTimes.detect;
+            times->describe = frameTimes.describe;
+        }
+        CompressDescriptors(descriptors, params, times);
+        // push descriptors for current frame to end of data buffer
+        newFrame = DataFrame(imgGray, keypoints, descriptors);
+        FT_LOG_DEBUG("#3 : EXTRACT DESCRIPTORS done");
+    }
 
+    if (cache.Enabled())
+        cache.Store(featureKey, newFrame.features);
     return newFrame;
-    
 }
 
-std::unique_ptr<KPDetector> CreateDetector(std::string _detectorType)
+std::unique_ptr<KPDetector> CreateDetector(std::string _detectorType, int cornerBudget, bool bNativeCorners)
 {
-    cout << "Creating detector with type: " << _detectorType << "\n";
+    FT_LOG_INFO("Creating detector with type: " << _detectorType);
     std::unique_ptr<KPDetector> detector;
     if (_detectorType.compare("SHITOMASI") == 0)
-        detector = std::make_unique<DetectorShiTomasi>();
+        detector = std::make_unique<DetectorShiTomasi>(cornerBudget, bNativeCorners);
     else if (_detectorType.compare("HARRIS") == 0)
-        detector = std::make_unique<DetectorHarris>();
+        detector = std::make_unique<DetectorHarris>(cornerBudget, bNativeCorners);
     else if (_detectorType.compare("FAST") == 0)
         detector = std::make_unique<DetectorFast>();
     else if (_detectorType.compare("BRISK") == 0)
@@ -84,15 +328,30 @@ std::unique_ptr<KPDetector> CreateDetector(std::string _detectorType)
         detector = std::make_unique<DetectorSift>();
     else
     {
-        cout << _detectorType  << " is not a valid detector type!"<< "\n";
+        FT_LOG_ERROR(_detectorType << " is not a valid detector type!");
         return nullptr;
     }
     return detector;
 }
 
+// create the detector given by the settings, wrapped into a tiled detector if tiling is enabled
+std::unique_ptr<KPDetector> CreateDetector(const Params& params)
+{
+    if (!params.bTiledDetection)
+        return CreateDetector(params.detectorType, params.cornerBudget, params.bNativeCorners);
+
+    if (CreateDetector(params.detectorType) == nullptr)
+        return nullptr;
+    const std::string detectorType = params.detectorType;
+    const int cornerBudget = params.cornerBudget;
+    const bool bNativeCorners = params.bNativeCorners;
+    return std::make_unique<DetectorTiled>([=]() { return CreateDetector(detectorType, cornerBudget, bNativeCorners); },
+                                           params.tileRows, params.tileCols, params.tileOverlap, params.tileBudget);
+}
+
 cv::Ptr<cv::DescriptorExtractor> CreateDescriptor(std::string _descriptorType)
 {
-    cout << "Creating descriptor of type: " << _descriptorType << "\n";
+    FT_LOG_INFO("Creating descriptor of type: " << _descriptorType);
     cv::Ptr<cv::DescriptorExtractor> extractor;
     if (_descriptorType.compare("BRISK") == 0)
     {
@@ -114,12 +373,43 @@ cv::Ptr<cv::DescriptorExtractor> CreateDescriptor(std::string _descriptorType)
         extractor = cv::xfeatures2d::SIFT::create();
     else
     {
-        cout << _descriptorType  << " is not a valid descriptor type!"<< "\n";
+        FT_LOG_ERROR(_descriptorType << " is not a valid descriptor type!");
     }
 
     return extractor;
 }
 
+// parse rectangles given as "x,y,width,height;x,y,width,height;..."
+std::vector<cv::Rect> ParseRects(const std::string& str)
+{
+    std::vector<cv::Rect> rects;
+    std::istringstream is(str);
+    std::string rectStr;
+    while (std::getline(is, rectStr, ';'))
+    {
+        cv::Rect rect;
+        char sep;
+        std::istringstream isRect(rectStr);
+        if (isRect >> rect.x >> sep >> rect.y >> sep >> rect.width >> sep >> rect.height)
+            rects.push_back(rect);
+        else
+            FT_LOG_WARN("Ignoring invalid rectangle: " << rectStr);
+    }
+    return rects;
+}
+
+// items separated by ';', empty items are skipped
+std::vector<std::string> ParseList(const std::string& str)
+{
+    std::vector<std::string> items;
+    std::istringstream is(str);
+    std::string item;
+    while (std::getline(is, item, ';'))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
 Params LoadParamsFromFile(std::string fname)
 {
     Params p;
@@ -146,11 +436,16 @@ Params LoadParamsFromFile(std::string fname)
         }
     }
 
+    // the log level applies from here on, so it also controls printing the params
+    if (paramsMap.count("logLevel")) p.logLevel = paramsMap["logLevel"];
+    SetLogLevel(ParseLogLevel(p.logLevel));
+    if (paramsMap.count("traceFile")) p.traceFile = paramsMap["traceFile"];
+
     // print params
-    cout << "######### LOADED PARAMS ########" << "\n";
+    FT_LOG_INFO("######### LOADED PARAMS ########");
     for (auto it = paramsMap.begin(); it != paramsMap.end(); ++it)
-        cout << it->first << " : " << it->second << "\n";
-    cout << "################################" << "\n\n";
+        FT_LOG_INFO(it->first << " : " << it->second);
+    FT_LOG_INFO("################################\n");
 
     p.detectorType = paramsMap["detectorType"];
     p.descriptorType = paramsMap["descriptorType"];
@@ -159,5 +454,75 @@ Params LoadParamsFromFile(std::string fname)
     p.bFocusOnVehicle = std::stoi(paramsMap["bFocusOnVehicle"]);
     p.normType = std::stoi(paramsMap["normType"]);
     p.visualizeMatches = std::stoi(paramsMap["visualizeMatches"]);
+
+    // optional settings, keep the defaults if they are missing from the file
+    if (paramsMap.count("focusRects")) p.focusRects = ParseRects(paramsMap["focusRects"]);
+    if (paramsMap.count("bRoiFirst")) p.bRoiFirst = std::stoi(paramsMap["bRoiFirst"]);
+    if (paramsMap.count("roiPadding")) p.roiPadding = std::stoi(paramsMap["roiPadding"]);
+    if (paramsMap.count("featureCacheDir")) p.featureCacheDir = paramsMap["featureCacheDir"];
+    if (paramsMap.count("cornerBudget")) p.cornerBudget = std::stoi(paramsMap["cornerBudget"]);
+    if (paramsMap.count("bNativeCorners")) p.bNativeCorners = std::stoi(paramsMap["bNativeCorners"]);
+    if (paramsMap.count("descCompression")) p.descCompression = paramsMap["descCompression"];
+    if (paramsMap.count("descPcaFile")) p.descPcaFile = paramsMap["descPcaFile"];
+    if (paramsMap.count("descPcaDims")) p.descPcaDims = std::stoi(paramsMap["descPcaDims"]);
+    if (paramsMap.count("bLearnDescPca")) p.bLearnDescPca = std::stoi(paramsMap["bLearnDescPca"]);
+    if (paramsMap.count("maxKeypoints")) p.maxKeypoints = std::stoi(paramsMap["maxKeypoints"]);
+    if (paramsMap.count("latencyTargetMs")) p.latencyTargetMs = std::stod(paramsMap["latencyTargetMs"]);
+    if (paramsMap.count("budgetMin")) p.budgetMin = std::stoi(paramsMap["budgetMin"]);
+    if (paramsMap.count("budgetMax")) p.budgetMax = std::stoi(paramsMap["budgetMax"]);
+    if (paramsMap.count("bStaticPipeline")) p.bStaticPipeline = std::stoi(paramsMap["bStaticPipeline"]);
+    if (paramsMap.count("bFusedDetectDescribe")) p.bFusedDetectDescribe = std::stoi(paramsMap["bFusedDetectDescribe"]);
+    if (paramsMap.count("bTiledDetection")) p.bTiledDetection = std::stoi(paramsMap["bTiledDetection"]);
+    if (paramsMap.count("tileRows")) p.tileRows = std::stoi(paramsMap["tileRows"]);
+    if (paramsMap.count("tileCols")) p.tileCols = std::stoi(paramsMap["tileCols"]);
+    if (paramsMap.count("tileOverlap")) p.tileOverlap = std::stoi(paramsMap["tileOverlap"]);
+    if (paramsMap.count("tileBudget")) p.tileBudget = std::stoi(paramsMap["tileBudget"]);
+    if (paramsMap.count("matchRatio")) p.matchRatio = std::stod(paramsMap["matchRatio"]);
+    if (paramsMap.count("bCrossCheck")) p.bCrossCheck = std::stoi(paramsMap["bCrossCheck"]);
+    if (paramsMap.count("bFlannIncremental")) p.bFlannIncremental = std::stoi(paramsMap["bFlannIncremental"]);
+    if (paramsMap.count("flannBinaryIndex")) p.flannBinaryIndex = paramsMap["flannBinaryIndex"];
+    if (paramsMap.count("flannTrees")) p.flannTrees = std::stoi(paramsMap["flannTrees"]);
+    if (paramsMap.count("flannChecks")) p.flannChecks = std::stoi(paramsMap["flannChecks"]);
+    if (paramsMap.count("flannLshTables")) p.flannLshTables = std::stoi(paramsMap["flannLshTables"]);
+    if (paramsMap.count("flannLshKeySize")) p.flannLshKeySize = std::stoi(paramsMap["flannLshKeySize"]);
+    if (paramsMap.count("flannLshProbes")) p.flannLshProbes = std::stoi(paramsMap["flannLshProbes"]);
+    if (paramsMap.count("bGatedMatching")) p.bGatedMatching = std::stoi(paramsMap["bGatedMatching"]);
+    if (paramsMap.count("gateRadius")) p.gateRadius = std::stof(paramsMap["gateRadius"]);
+    if (paramsMap.count("bGateMotionPrior")) p.bGateMotionPrior = std::stoi(paramsMap["bGateMotionPrior"]);
+    if (paramsMap.count("bGeomVerify")) p.bGeomVerify = std::stoi(paramsMap["bGeomVerify"]);
+    if (paramsMap.count("geomModel")) p.geomModel = paramsMap["geomModel"];
+    if (paramsMap.count("geomThreshold")) p.geomThreshold = std::stof(paramsMap["geomThreshold"]);
+    if (paramsMap.count("geomConfidence")) p.geomConfidence = std::stod(paramsMap["geomConfidence"]);
+    if (paramsMap.count("geomMaxIters")) p.geomMaxIters = std::stoi(paramsMap["geomMaxIters"]);
+    if (paramsMap.count("geomMinMatches")) p.geomMinMatches = std::stoi(paramsMap["geomMinMatches"]);
+    if (paramsMap.count("bGeomRemoveOutliers")) p.bGeomRemoveOutliers = std::stoi(paramsMap["bGeomRemoveOutliers"]);
+    if (paramsMap.count("bKltTracking")) p.bKltTracking = std::stoi(paramsMap["bKltTracking"]);
+    if (paramsMap.count("kltKeyframeInterval")) p.kltKeyframeInterval = std::stoi(paramsMap["kltKeyframeInterval"]);
+    if (paramsMap.count("kltMinTracks")) p.kltMinTracks = std::stoi(paramsMap["kltMinTracks"]);
+    if (paramsMap.count("kltWinSize")) p.kltWinSize = std::stoi(paramsMap["kltWinSize"]);
+    if (paramsMap.count("kltPyrLevels")) p.kltPyrLevels = std::stoi(paramsMap["kltPyrLevels"]);
+    if (paramsMap.count("bTrackHistory")) p.bTrackHistory = std::stoi(paramsMap["bTrackHistory"]);
+    if (paramsMap.count("trackMaxLost")) p.trackMaxLost = std::stoi(paramsMap["trackMaxLost"]);
+    if (paramsMap.count("trackMaxHistory")) p.trackMaxHistory = std::stoi(paramsMap["trackMaxHistory"]);
+    if (paramsMap.count("sourceType")) p.sourceType = paramsMap["sourceType"];
+    if (paramsMap.count("sourcePath")) p.sourcePath = paramsMap["sourcePath"];
+    if (paramsMap.count("firstFrame")) p.firstFrame = std::stoi(paramsMap["firstFrame"]);
+    if (paramsMap.count("numFrames")) p.numFrames = std::stoi(paramsMap["numFrames"]);
+    if (paramsMap.count("decodeThreads")) p.decodeThreads = std::stoi(paramsMap["decodeThreads"]);
+    if (paramsMap.count("prefetchFrames")) p.prefetchFrames = std::stoi(paramsMap["prefetchFrames"]);
+    if (paramsMap.count("rawExportFile")) p.rawExportFile = paramsMap["rawExportFile"];
+    if (paramsMap.count("pipelineMode")) p.pipelineMode = std::stoi(paramsMap["pipelineMode"]);
+    if (paramsMap.count("numDetectWorkers")) p.numDetectWorkers = std::stoi(paramsMap["numDetectWorkers"]);
+    if (paramsMap.count("queueCapacity")) p.queueCapacity = std::stoi(paramsMap["queueCapacity"]);
+    if (paramsMap.count("batchMode")) p.batchMode = std::stoi(paramsMap["batchMode"]);
+    if (paramsMap.count("batchWorkers")) p.batchWorkers = std::stoi(paramsMap["batchWorkers"]);
+    if (paramsMap.count("streamSources")) p.streamSources = ParseList(paramsMap["streamSources"]);
+    if (paramsMap.count("streamWorkers")) p.streamWorkers = std::stoi(paramsMap["streamWorkers"]);
+    if (paramsMap.count("bPinThreads")) p.bPinThreads = std::stoi(paramsMap["bPinThreads"]);
+    if (paramsMap.count("dataBufferSize")) p.dataBufferSize = std::stoi(paramsMap["dataBufferSize"]);
+    if (paramsMap.count("benchThreads")) p.benchThreads = std::stoi(paramsMap["benchThreads"]);
+    if (paramsMap.count("benchRuns")) p.benchRuns = std::stoi(paramsMap["benchRuns"]);
+    if (paramsMap.count("benchWarmupRuns")) p.benchWarmupRuns = std::stoi(paramsMap["benchWarmupRuns"]);
+    if (paramsMap.count("benchOutput")) p.benchOutput = paramsMap["benchOutput"];
     return p;
 }
@@ -13,12 +13,25 @@ void AddToRingBuffer(const DataFrame& frame);
 void VisualizeMatches(std::vector<cv::DMatch> matches);
 void LimitKeyPoints(std::vector<cv::KeyPoint>& keypoints, const Params& p);
 
-void LimitKeyPointsRect(std::vector<cv::KeyPoint>& keypoints);
+void LimitKeyPointsRect(std::vector<cv::KeyPoint>& keypoints, const std::vector<cv::Rect>& rects);
+void RetainStrongest(std::vector<cv::KeyPoint>& keypoints, int maxKeypoints);
+void RetainStrongest(std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors, int maxKeypoints);
+void LimitFeaturesRect(std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors, const std::vector<cv::Rect>& rects);
 DataFrame DetectAndDescribeFeatures(const cv::Mat& imgGray,
                                     const std::unique_ptr<KPDetector>& _detector,
                                     const cv::Ptr<cv::DescriptorExtractor>& _descriptor,
-                                    const Params& params);
-std::unique_ptr<KPDetector> CreateDetector(std::string _detectorType);
+                                    const Params& params,
+                                    StageTimes* times = nullptr);
+DataFrame DetectAndDescribeFeaturesRoi(const cv::Mat& imgGray,
+                                       const std::unique_ptr<KPDetector>& _detector,
+                                       const cv::Ptr<cv::DescriptorExtractor>& _descriptor,
+                                       const Params& params,
+                                       StageTimes* times = nullptr);
+// cornerBudget and bNativeCorners are used by SHITOMASI and HARRIS
+std::unique_ptr<KPDetector> CreateDetector(std::string _detectorType, int cornerBudget = 0, bool bNativeCorners = true);
+std::unique_ptr<KPDetector> CreateDetector(const Params& params);
 cv::Ptr<cv::DescriptorExtractor> CreateDescriptor(std::string _descriptorType);
+std::vector<cv::Rect> ParseRects(const std::string& str);
+std::vector<std::string> ParseList(const std::string& str);
 Params LoadParamsFromFile(std::string fname);
 